@@ -605,9 +605,9 @@
  *   PWM on pin OC2A. Only use this option if you don't need PWM on 0C2A. (Check your schematic.)
  *   USE_OCR2A_AS_TOP sacrifices duty cycle control resolution to achieve this broader range of frequencies.
  */
-//#define FAST_PWM_FAN    // Increase the fan PWM frequency. Removes the PWM noise but increases heating in the FET/Arduino
+#define FAST_PWM_FAN    // Increase the fan PWM frequency. Removes the PWM noise but increases heating in the FET/Arduino
 #if ENABLED(FAST_PWM_FAN)
-  //#define FAST_PWM_FAN_FREQUENCY 31400  // Define here to override the defaults below
+  #define FAST_PWM_FAN_FREQUENCY 25000U   // UNI: FAN0 (PA10, TIM1) and FAN1 (PA15, TIM2) have MOSFET drivers; 25kHz is inaudible
   //#define USE_OCR2A_AS_TOP
   #ifndef FAST_PWM_FAN_FREQUENCY
     #ifdef __AVR__
@@ -879,13 +879,15 @@
 
 //#define SENSORLESS_BACKOFF_MM  { 2, 2, 0 }  // (linear=mm, rotational=°) Backoff from endstops before sensorless homing
 
-#define HOMING_BUMP_MM      { 5, 5, 2 }       // (linear=mm, rotational=°) Backoff from endstops after first bump
-#define HOMING_BUMP_DIVISOR { 2, 2, 4 }       // Re-Bump Speed Divisor (Divides the Homing Feedrate)
+// UNI: with ENDSTOP_INTERRUPTS_FEATURE the optocoupler delay moves the stop point by less than one
+// step, so a short, faster second bump is as repeatable (see buildroot/share/scripts/uni_homing.py)
+#define HOMING_BUMP_MM      { 2, 2, 1 }       // (linear=mm, rotational=°) Backoff from endstops after first bump
+#define HOMING_BUMP_DIVISOR { 2, 2, 2 }       // Re-Bump Speed Divisor (Divides the Homing Feedrate)
 
 //#define HOMING_BACKOFF_POST_MM { 2, 2, 2 }  // (linear=mm, rotational=°) Backoff from endstops after homing
 //#define XY_COUNTERPART_BACKOFF_MM 0         // (mm) Backoff X after homing Y, and vice-versa
 
-//#define QUICK_HOME                          // If G28 contains XY do a diagonal move first
+#define QUICK_HOME                            // If G28 contains XY do a diagonal move first
 //#define HOME_Y_BEFORE_X                     // If G28 contains XY home Y before X
 //#define HOME_Z_FIRST                        // Home Z first. Requires a real endstop (not a probe).
 //#define CODEPENDENT_XY_HOMING               // If X/Y can't home without homing Y/X first
@@ -1120,6 +1122,9 @@
  * Idle Stepper Shutdown
  * Enable DISABLE_IDLE_* to shut down axis steppers after an idle period.
  * The default timeout duration can be overridden with M18 and M84. Set to 0 for No Timeout.
+ *
+ * UNI: X, Y, Z and E0 share ENABLE_PIN PA8 and power down together once the last of them goes
+ * idle, after which no axis position is trusted. Keep DISABLE_IDLE_X/Y/Z/E all on or all off.
  */
 #define DEFAULT_STEPPER_TIMEOUT_SEC 120
 #define DISABLE_IDLE_X
@@ -2390,19 +2395,22 @@
 
 // The number of linear moves that can be in the planner at once.
 // The value of BLOCK_BUFFER_SIZE must be a power of 2 (e.g., 8, 16, 32)
+// The STM32F401CC has 64K SRAM, enough for a deep look-ahead on short ARC_SUPPORT segments.
+// The UNI build report prints the resulting RAM use; buildroot/share/scripts/uni_lookahead.py
+// shows the feedrate each depth sustains on a given G-code file.
 #if BOTH(SDSUPPORT, DIRECT_STEPPING)
   #define BLOCK_BUFFER_SIZE  8
 #elif ENABLED(SDSUPPORT)
-  #define BLOCK_BUFFER_SIZE 16
+  #define BLOCK_BUFFER_SIZE 32
 #else
-  #define BLOCK_BUFFER_SIZE 16
+  #define BLOCK_BUFFER_SIZE 64
 #endif
 
 // @section serial
 
 // The ASCII buffer for serial input
 #define MAX_CMD_SIZE 96
-#define BUFSIZE 4
+#define BUFSIZE 16
 
 // Transmission to Host Buffer Size
 // To save 386 bytes of flash (and TX_BUFFER_SIZE+3 bytes of RAM) set to 0.
@@ -2466,6 +2474,9 @@
  * - During Hold all Emergency Parser commands are available, as usual.
  * - Enable NANODLP_Z_SYNC and NANODLP_ALL_AXIS for move command end-state reports.
  */
+// Disabled for the UNI: the emergency parser formats the S000 report inside the USB receive interrupt,
+// which is what status polling must not do. Poll M114 instead: it waits for a command slot and is
+// answered from the main loop. Measure with buildroot/share/scripts/uni_status_bench.py.
 //#define REALTIME_REPORTING_COMMANDS
 #if ENABLED(REALTIME_REPORTING_COMMANDS)
   //#define FULL_REPORT_TO_HOST_FEATURE   // Auto-report the machine status like Grbl CNC
@@ -2480,14 +2491,18 @@
 //#define NO_TIMEOUTS 1000 // (ms)
 
 // Some clients will have this feature soon. This could make the NO_TIMEOUTS unnecessary.
-//#define ADVANCED_OK
+// Enabled for the UNI: each "ok" carries the free planner blocks (P) and command slots (B),
+// so a streaming host can keep the queue full. See buildroot/share/scripts/uni_stream.py --credit.
+#define ADVANCED_OK
 
 // Printrun may have trouble receiving long strings all at once.
 // This option inserts short delays between lines of serial output.
-#define SERIAL_OVERRUN_PROTECTION
+// Disabled for the UNI: serial_delay() only pauses between the lines of long reports (M503,
+// M115 and the like), and native USB (SERIAL_PORT -1) has no UART receiver to overrun.
+//#define SERIAL_OVERRUN_PROTECTION
 
 // For serial echo, the number of digits after the decimal point
-//#define SERIAL_FLOAT_PRECISION 4
+//#define SERIAL_FLOAT_PRECISION 4     // UNI: keep the default; every extra digit adds 4 bytes to each M114 reply
 
 /**
  * Set the number of proportional font spaces required to fill up a typical character space.
@@ -3333,12 +3348,17 @@
 //#define SPINDLE_FEATURE
 //#define LASER_FEATURE
 #if EITHER(SPINDLE_FEATURE, LASER_FEATURE)
+  //#define UNI_HOTBED_DISCONNECTED            // UNI: confirm nothing is wired to the HOTBED terminals. The cutter
+                                               //  PWM on PB3 also switches the bed MOSFET Q1.
   #define SPINDLE_LASER_ACTIVE_STATE    LOW    // Set to "HIGH" if SPINDLE_LASER_ENA_PIN is active HIGH
 
   #define SPINDLE_LASER_USE_PWM                // Enable if your controller supports setting the speed/power
   #if ENABLED(SPINDLE_LASER_USE_PWM)
     #define SPINDLE_LASER_PWM_INVERT    false  // Set to "true" if the speed/power goes up when you want it to go slower
-    #define SPINDLE_LASER_FREQUENCY     2500   // (Hz) Spindle/laser frequency (only on supported HALs: AVR, ESP32, and LPC)
+    #define SPINDLE_LASER_FREQUENCY    25000   // (Hz) Spindle/laser frequency (only on supported HALs: AVR, ESP32, and LPC)
+                                               // UNI: PB3 shares TIM2 with FAN1, so this must match FAST_PWM_FAN_FREQUENCY.
+                                               //  U16 filters it into the 0-10V RPM output. Marlin writes an 8-bit duty (256 levels),
+                                               //  and CUTTER_POWER_UNIT RPM rounds to whole percent first: 101 speeds, 1% of the range apart.
                                                // ESP32: If SPINDLE_LASER_PWM_PIN is onboard then <=78125Hz. For I2S expander
                                                //  the frequency determines the PWM resolution. 2500Hz = 0-100, 977Hz = 0-255, ...
                                                //  (250000 / SPINDLE_LASER_FREQUENCY) = max value.
@@ -3369,7 +3389,11 @@
    *  - RPM     (S0 - S50000)  Best for use with a spindle
    *  - SERVO   (S0 - S180)
    */
-  #define CUTTER_POWER_UNIT PWM255
+  #if ENABLED(SPINDLE_FEATURE)
+    #define CUTTER_POWER_UNIT RPM      // UNI: S in RPM on the 0-10V DAC; fit SPEED_POWER_MIN/MAX with uni_spindle.py --calibrate
+  #else
+    #define CUTTER_POWER_UNIT PWM255
+  #endif
 
   /**
    * Relative Cutter Power
@@ -3386,7 +3410,12 @@
     #define SPINDLE_CHANGE_DIR_STOP            // Enable if the spindle should stop before changing spin direction
     #define SPINDLE_INVERT_DIR          false  // Set to "true" if the spin direction is reversed
 
-    #define SPINDLE_LASER_POWERUP_DELAY   5000 // (ms) Delay to allow the spindle/laser to come up to speed/power
+    // UNI: a BLDC driver on the RPM output ramps at its own rate. buildroot/share/scripts/uni_spindle.py replays a
+    // job against that ramp and reports the delays needed and the dwell time a per-block ramp would save.
+    // Delays below are its worst case for any job at the default +8000/-6000 RPM/s ramp. POWERUP also follows
+    // an M3 that slows the spindle: SPEED_POWER_MAX down to SPEED_POWER_MIN within 5% takes longer than 0 to
+    // SPEED_POWER_MAX. POWERDOWN is a full stop from SPEED_POWER_MAX. Rerun it with the driver's real ramp rates.
+    #define SPINDLE_LASER_POWERUP_DELAY   4200 // (ms) Delay to allow the spindle/laser to come up to speed/power
     #define SPINDLE_LASER_POWERDOWN_DELAY 5000 // (ms) Delay to allow the spindle to stop
 
     /**
@@ -3454,7 +3483,8 @@
      * CUTTER_MODE_CONTINUOUS. The option allows M3 laser power to be committed without waiting
      * for a planner synchronization
      */
-    //#define LASER_POWER_SYNC
+    // UNI: TTL lasers on PB3 at SPINDLE_LASER_FREQUENCY. M3 S changes ride in the planner blocks.
+    #define LASER_POWER_SYNC
 
     /**
      * Scale the laser's power in proportion to the movement rate.
@@ -3463,7 +3493,9 @@
      * - Ramps the power up every N steps to approximate the speed trapezoid.
      * - Due to the limited power resolution this is only approximate.
      */
-    //#define LASER_POWER_TRAP
+    // UNI: cuts the over-burn where raster lines end and at corners from up to 7x to about 1.3x
+    // (buildroot/share/scripts/uni_laser.py compares it with power proportional to speed)
+    #define LASER_POWER_TRAP
 
     //
     // Laser I2C Ammeter (High precision INA226 low/high side module)
@@ -3617,8 +3649,9 @@
 
 /**
  * Auto-report position with M154 S<seconds>
+ * UNI: reported from idle(), in whole seconds. Poll M114 for faster updates.
  */
-//#define AUTO_REPORT_POSITION
+#define AUTO_REPORT_POSITION
 
 /**
  * Include capabilities in M115 output
@@ -3716,6 +3749,9 @@
  */
 //#define PAREN_COMMENTS      // Support for parentheses-delimited comments
 //#define GCODE_MOTION_MODES  // Remember the motion mode (G0 G1 G2 G3 G5 G38.X) and apply for X Y Z E F, etc.
+#if EITHER(SPINDLE_FEATURE, LASER_FEATURE)
+  #define GCODE_MOTION_MODES  // UNI: CAM and laser output leaves out repeated G1, as uni_spindle.py and uni_laser.py assume
+#endif
 
 // Enable and set a (default) feedrate for all G0 moves
 //#define G0_FEEDRATE 3000 // (mm/min)
@@ -31,6 +31,9 @@
 //
 // Limit Switches
 //
+// MIN and MAX share one input per axis. Endstops::update() only tests the endstop in the direction
+// of travel, so a trigger is attributed to the end being approached. With ENDSTOP_INTERRUPTS_FEATURE
+// the inputs use EXTI lines 2, 10 and 14. BTN_EN2 (PC14) is also on line 14, but the encoder is polled.
 #ifndef X_STOP_PIN      
   #ifndef X_MIN_PIN     
     #define X_MIN_PIN      PB2
@@ -77,6 +80,27 @@
 #define E0_DIR_PIN         PB12
 #define E0_ENABLE_PIN      PA8
 
+// PA8 is released only when every axis of the group is disabled, so idle shutdown is all or nothing.
+// A partial DISABLE_IDLE_* set would never power the drivers down.
+#if ENABLED(DISABLE_IDLE_X) != ENABLED(DISABLE_IDLE_Y) || ENABLED(DISABLE_IDLE_X) != ENABLED(DISABLE_IDLE_Z) || ENABLED(DISABLE_IDLE_X) != ENABLED(DISABLE_IDLE_E)
+  #error "X, Y, Z and E0 share ENABLE_PIN PA8. Enable all or none of DISABLE_IDLE_X/Y/Z/E."
+#endif
+
+// All STEP and DIR pins are on GPIOB, so one BSRR word can carry the edges of every axis.
+// Bits must match the pins above (checked by buildroot/share/PlatformIO/scripts/uni_build_report.py).
+#define STEPPER_SHARED_PORT GPIOB
+#define X_STEP_PORT_BIT     9
+#define X_DIR_PORT_BIT      8
+#define Y_STEP_PORT_BIT     5
+#define Y_DIR_PORT_BIT      4
+#define Z_STEP_PORT_BIT    15
+#define Z_DIR_PORT_BIT     14
+#define E0_STEP_PORT_BIT   13
+#define E0_DIR_PORT_BIT    12
+
+#define STEP_PORT_MASK     (_BV(X_STEP_PORT_BIT) | _BV(Y_STEP_PORT_BIT) | _BV(Z_STEP_PORT_BIT) | _BV(E0_STEP_PORT_BIT))
+#define DIR_PORT_MASK      (_BV(X_DIR_PORT_BIT)  | _BV(Y_DIR_PORT_BIT)  | _BV(Z_DIR_PORT_BIT)  | _BV(E0_DIR_PORT_BIT))
+
 //
 // Temperature Sensors
 //
@@ -87,7 +111,16 @@
 // Heaters / Fans
 //
 #define HEATER_0_PIN       PA9                                                 // HOTEND MOSFET
-#define HEATER_BED_PIN     PB3                                                 // BED MOSFET
+
+// PB3 (HOTBED net) drives the bed MOSFET Q1, the 3.3V TTL connector and the RPM connector: PWM filtered
+// into 0-10V by U16, with R605 setting the voltage at 100% duty. A spindle or laser takes it from the bed,
+// but Q1 still switches: a bed left on the HOTBED terminals heats on every M3/M4 with no thermal protection.
+// Disconnect the bed (or move the load to the RPM/TTL output) and define UNI_HOTBED_DISCONNECTED to confirm.
+#if EITHER(SPINDLE_FEATURE, LASER_FEATURE)
+  #define SPINDLE_LASER_PWM_PIN PB3                                            // RPM 0-10V / TTL / Q1
+#else
+  #define HEATER_BED_PIN   PB3                                                 // BED MOSFET
+#endif
 
 #define FAN0_PIN           PA10                                                // PRINT FAN
 #define FAN1_PIN           PA15                                                // HOTEND FAN
@@ -97,23 +130,65 @@
   #define E0_AUTO_FAN_PIN  FAN1_PIN
 #endif
 
+//
+// Timers
+//
+// STM32F401 has no TIM6/TIM7/TIM8. Servo and tone timers are set in ini/stm32f4.ini (TIM3/TIM4).
+#define STEP_TIMER          9
+#define TEMP_TIMER         10
+
+// Hardware PWM timer of each heater/fan output (AF1). Fans run from hardware PWM,
+// FAST_PWM_FAN sets their frequency per timer; heaters stay on Marlin's slow soft PWM.
+#define HEATER_0_PWM_TIMER  1                                                  // PA9  TIM1_CH2
+#define FAN0_PWM_TIMER      1                                                  // PA10 TIM1_CH3
+#define HEATER_BED_PWM_TIMER 2                                                 // PB3  TIM2_CH2
+#define FAN1_PWM_TIMER      2                                                  // PA15 TIM2_CH1
+
+#if STEP_TIMER == TEMP_TIMER
+  #error "STEP_TIMER and TEMP_TIMER must be different timers."
+#endif
+#if FAN0_PWM_TIMER == STEP_TIMER || FAN0_PWM_TIMER == TEMP_TIMER || FAN1_PWM_TIMER == STEP_TIMER || FAN1_PWM_TIMER == TEMP_TIMER
+  #error "FAN0_PIN / FAN1_PIN PWM timer conflicts with STEP_TIMER or TEMP_TIMER."
+#endif
+#if HEATER_0_PWM_TIMER == STEP_TIMER || HEATER_0_PWM_TIMER == TEMP_TIMER || HEATER_BED_PWM_TIMER == STEP_TIMER || HEATER_BED_PWM_TIMER == TEMP_TIMER
+  #error "HEATER_0_PIN / HEATER_BED_PIN timer conflicts with STEP_TIMER or TEMP_TIMER."
+#endif
+#if EITHER(SPINDLE_FEATURE, LASER_FEATURE)
+  #if TEMP_SENSOR_BED
+    #error "SPINDLE_FEATURE / LASER_FEATURE use PB3 (HOTBED) on the UNI. Set TEMP_SENSOR_BED 0."
+  #elif !defined(UNI_HOTBED_DISCONNECTED)
+    #error "PB3 still drives the bed MOSFET with SPINDLE_FEATURE / LASER_FEATURE. Disconnect the bed and define UNI_HOTBED_DISCONNECTED."
+  #elif ENABLED(FAST_PWM_FAN) && SPINDLE_LASER_FREQUENCY != FAST_PWM_FAN_FREQUENCY
+    #error "PB3 shares TIM2 with FAN1 (PA15). SPINDLE_LASER_FREQUENCY must equal FAST_PWM_FAN_FREQUENCY."
+  #endif
+#endif
+
 //*****************************************************************************
 //********************** EEPROM settings **************************************
 //*****************************************************************************
 
-// EEPROM Emulation type, select SDCARD if you don't use BOOTLOADER or select FLASH if you use BOOTLOADER
-//#define SDCARD_EEPROM_EMULATION
-#define FLASH_EEPROM_EMULATION
+// EEPROM Emulation type, SDCARD if you don't use BOOTLOADER or FLASH if you use BOOTLOADER.
+// Sector 1 is only free when the application starts at 0x08008000: env:blackpill_f401cc_uni_bootloader
+// sets -DUNI_BOOTLOADER. Linked at 0x08000000, M500 would erase the running firmware.
+#if ENABLED(FLASH_EEPROM_EMULATION) && !defined(UNI_BOOTLOADER)
+  #error "FLASH_EEPROM_EMULATION needs board_build.offset 0x8000 on the UNI. Build env:blackpill_f401cc_uni_bootloader or use SDCARD_EEPROM_EMULATION."
+#elif DISABLED(SDCARD_EEPROM_EMULATION) && defined(UNI_BOOTLOADER)
+  #define FLASH_EEPROM_EMULATION
+#else
+  #define SDCARD_EEPROM_EMULATION
+#endif
 
 #if ENABLED(FLASH_EEPROM_EMULATION)
   #define FLASH_EEPROM_LEVELING
   #define FLASH_SECTOR          1
   #define FLASH_UNIT_SIZE       0x4000                                         // 16k
   #define FLASH_ADDRESS_START   0x08004000                                     // board_build.offset = FLASH_ADDRESS_START - 0x08000000 +  FLASH_UNIT_SIZE
+  #define MARLIN_EEPROM_SIZE    0x800                                          // 2k slot: 8 M500 per sector erase (see buildroot/share/scripts/uni_eeprom_wear.py)
+                                                                               // SettingsData is well under 1k without a bed mesh; M500 reports the size
 #endif
 
 #if ENABLED(SDCARD_EEPROM_EMULATION)
-  #define MARLIN_EEPROM_SIZE    0x4000                                         // 16k
+  #define MARLIN_EEPROM_SIZE    0x800                                          // 2k: 10 sectors per M500 instead of 38 with FAT and directory entry, 14k less RAM (see uni_sd_eeprom.py)
 #endif
 
 //*****************************************************************************
@@ -151,9 +226,12 @@
 #define EXP_2_09_PIN                         PA5
 #define EXP_2_10_PIN                         PA6
 
-// SDCard
+// SDCard on SPI1, shared with the SPI-SD bootloader
 #ifdef SDSUPPORT
   #define SDSS                       EXP_2_07_PIN
+  #define SD_SCK_PIN                 EXP_2_09_PIN
+  #define SD_MISO_PIN                EXP_2_10_PIN
+  #define SD_MOSI_PIN                EXP_2_05_PIN
   #define SD_DETECT_PIN              -1
   #define KILL_PIN                   -1
 #endif
@@ -0,0 +1,161 @@
+#
+# uni_build_report.py
+# Flash/RAM budget report for the STM32F401CCU6 UNI release builds
+#
+# Writes a linker map next to firmware.elf and, once the ELF is linked, prints
+# flash and RAM usage grouped by Marlin subsystem plus the step rate needed to
+# reach DEFAULT_MAX_FEEDRATE on each axis. The planner and command queue
+# buffers are listed separately since they dominate the RAM budget, as are
+# the functions uni_ramfunc.py moved to SRAM.
+# With -flto the map lists the code under *.ltrans.o objects, so each input
+# section is traced back to its source through the symbol in its name and the
+# cross reference table (--cref, --no-demangle to keep the names comparable).
+# Before building, checks that the GPIOB port bits declared in the UNI pins
+# file match the STEP/DIR pins.
+#
+import pioutil
+if pioutil.is_pio_build():
+
+    import re
+    from pathlib import Path
+    Import("env")
+
+    map_path = Path(env.subst("$BUILD_DIR"), "firmware.map")
+    env.Append(LINKFLAGS=[ "-Wl,-Map," + str(map_path), "-Wl,--cref", "-Wl,--no-demangle" ])
+
+    # Output sections that occupy flash, RAM, or both (.data is copied at boot)
+    FLASH_SECTIONS = ('.isr_vector', '.text', '.rodata', '.ARM.extab', '.ARM', '.preinit_array', '.init_array', '.fini_array', '.data')
+    RAM_SECTIONS = ('.data', '.bss')
+
+    def subsystem(objpath):
+        """Group an object file by Marlin/src/<dir>, splitting out module/* since the hot paths live there."""
+        p = objpath.replace('\\', '/')
+        m = re.search(r'/src/src/([^/]+)(?:/([^/.]+))?', p)
+        if m:
+            top, sub = m.groups()
+            if top == 'module' and sub: return 'module/' + sub
+            return top
+        if 'FrameworkArduino' in p or 'framework-arduinoststm32' in p: return '(framework)'
+        if '/lib' in p: return '(libraries)'
+        if p.endswith('.ltrans.o'): return '(lto, unattributed)'
+        return '(toolchain)'
+
+    def section_symbol(name):
+        """Symbol of a -ffunction-sections/-fdata-sections input section, without GCC's clone and LTO suffixes."""
+        m = re.match(r'^\.(?:text|rodata|data|bss|RamFunc)(?:\.(?:startup|hot|unlikely))?\.(.+)$', name)
+        if not m: return None
+        return re.sub(r'\.(?:lto_priv|constprop|isra|part|cold|localalias)\b.*$', '', m.group(1))
+
+    # Large RAM buffers sized in Configuration_adv.h, by mangled symbol
+    RAM_BUFFERS = {
+        '_ZN7Planner12block_bufferE': 'Planner block_buffer (BLOCK_BUFFER_SIZE)',
+        '_ZN10GCodeQueue11ring_bufferE': 'Command queue (BUFSIZE x MAX_CMD_SIZE)',
+    }
+
+    def parse_cref(lines):
+        """{symbol: source object} from the cross reference table, skipping LTO partitions."""
+        sources, symbol = {}, None
+        for line in lines:
+            if not line.strip() or line.startswith('Symbol '): continue
+            fields = line.split()
+            if not line[0].isspace(): symbol = fields.pop(0)
+            if symbol and fields and symbol not in sources and not fields[-1].endswith('.ltrans.o'):
+                sources[symbol] = fields[-1]
+        return sources
+
+    def parse_map(path):
+        """Return ({subsystem: [flash, ram]}, {RAM_BUFFERS key: size}, {.RamFunc symbol: size}) from a GNU ld map file."""
+        usage, buffers, ramfuncs = {}, {}, {}
+        section = input_section = None
+        lines = path.read_text(errors='ignore').splitlines()
+        start = next((i for i, l in enumerate(lines) if l.startswith('Linker script and memory map')), len(lines))
+        end = next((i for i, l in enumerate(lines) if l.startswith('Cross Reference Table')), len(lines))
+        sources = parse_cref(lines[end + 1:])
+        for line in lines[start + 1:end]:
+            m = re.match(r'^(\.[\w.]+)', line)
+            if m:
+                section = m.group(1)
+                continue
+            if section is None: continue
+            m = re.match(r'^\s+(\.\S+)\s*$', line)
+            if m:
+                input_section = m.group(1)
+                continue
+            m = re.match(r'^\s+(\S+\s+)?0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+\.o\)?)\s*$', line)
+            if not m: continue
+            name, size = (m.group(1) or input_section or '').strip(), int(m.group(3), 16)
+            input_section = None
+            if size == 0: continue
+            symbol = section_symbol(name)
+            if symbol in RAM_BUFFERS: buffers[symbol] = size
+            if name.startswith('.RamFunc.'): ramfuncs[symbol] = size
+            obj = m.group(4)
+            if obj.endswith('.ltrans.o'): obj = sources.get(symbol, obj)
+            entry = usage.setdefault(subsystem(obj), [0, 0])
+            if section in FLASH_SECTIONS: entry[0] += size
+            if section in RAM_SECTIONS: entry[1] += size
+        return usage, buffers, ramfuncs
+
+    def config_array(name):
+        """Read a '{ a, b, c }' array #define from Configuration.h."""
+        text = Path(env.subst("$PROJECT_DIR"), "Marlin", "Configuration.h").read_text(errors='ignore')
+        m = re.search(r'^\s*#define\s+' + name + r'\s*\{([^}]*)\}', text, re.M)
+        return [ float(v) for v in m.group(1).split(',') ] if m else []
+
+    def check_port_bits():
+        """Verify the *_PORT_BIT values in the UNI pins file match the STEP/DIR pins they stand for."""
+        pins = Path(env.subst("$PROJECT_DIR"), "Marlin", "src", "pins", "stm32f4", "pins_STM32F401CCU6_UNI.h").read_text(errors='ignore')
+        defs = dict(re.findall(r'^\s*#define\s+(\w+)\s+(\S+)', pins, re.M))
+        masks = { 'STEP': 0, 'DIR': 0 }
+        for axis in ('X', 'Y', 'Z', 'E0'):
+            for kind in masks:
+                pin, bit = defs.get('%s_%s_PIN' % (axis, kind)), defs.get('%s_%s_PORT_BIT' % (axis, kind))
+                if bit is None: continue
+                m = re.match(r'P([A-K])(\d+)$', pin or '')
+                if not m or 'GPIO' + m.group(1) != defs.get('STEPPER_SHARED_PORT') or int(m.group(2)) != int(bit):
+                    print("Error: %s_%s_PORT_BIT %s does not match %s_%s_PIN %s" % (axis, kind, bit, axis, kind, pin))
+                    env.Exit(1)
+                masks[kind] |= 1 << int(bit)
+        if masks['STEP'] & masks['DIR']:
+            print("Error: STEP_PORT_MASK and DIR_PORT_MASK overlap")
+            env.Exit(1)
+        print("STEP_PORT_MASK 0x%04X, DIR_PORT_MASK 0x%04X" % (masks['STEP'], masks['DIR']))
+
+    check_port_bits()
+
+    def report(source, target, env):
+        board = env.BoardConfig()
+        offset = int(board.get("build.offset", "0"), 16)
+        flash_max = int(board.get("upload.maximum_size")) - offset
+        ram_max = int(board.get("upload.maximum_ram_size"))
+
+        usage, buffers, ramfuncs = parse_map(map_path) if map_path.exists() else ({}, {}, {})
+        flash_total = sum(u[0] for u in usage.values())
+        ram_total = sum(u[1] for u in usage.values())
+
+        print("\nSTM32F401CCU6_UNI build report (%s)" % env.subst("$PIOENV"))
+        print("  %-24s %10s %10s" % ("Subsystem", "Flash", "RAM"))
+        for name, (flash, ram) in sorted(usage.items(), key=lambda kv: -kv[1][0]):
+            print("  %-24s %10d %10d" % (name, flash, ram))
+        print("  %-24s %10d %10d" % ("Total", flash_total, ram_total))
+        print("  %-24s %10d %10d" % ("Available", flash_max, ram_max))
+        for symbol, label in RAM_BUFFERS.items():
+            if symbol in buffers: print("  %-42s %10d" % (label, buffers[symbol]))
+        print("  %-42s %10d" % ("RAM left for stack and heap", ram_max - ram_total))
+        if ramfuncs:
+            print("  Running from SRAM (uni_ramfunc.py):")
+            for name, size in sorted(ramfuncs.items()):
+                print("    %-40s %10d" % (name, size))
+
+        steps = config_array('DEFAULT_AXIS_STEPS_PER_UNIT')
+        feeds = config_array('DEFAULT_MAX_FEEDRATE')
+        if steps and feeds:
+            rates = [ s * f for s, f in zip(steps, feeds) ]
+            print("  Step rate at DEFAULT_MAX_FEEDRATE (Hz): " + ", ".join("%.0f" % r for r in rates))
+            print("  Highest step rate needed at DEFAULT_MAX_FEEDRATE: %.0f Hz (uni_step_rate.py gives the rate a G-code file demands)" % max(rates))
+
+        if flash_total > flash_max or ram_total > ram_max:
+            print("Error: firmware exceeds the STM32F401CC flash/RAM budget!")
+            env.Exit(1)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)
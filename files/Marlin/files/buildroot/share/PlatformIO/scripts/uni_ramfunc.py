@@ -0,0 +1,54 @@
+#
+# uni_ramfunc.py
+# Run selected stepper/endstop functions from SRAM on the STM32F401CCU6 UNI
+#
+# At 84 MHz the F401 reads flash with wait states, and ART accelerator misses
+# add jitter to the stepper ISR. Functions matching 'custom_uni_ramfunc'
+# (fnmatch patterns on mangled names) have their .text.* sections renamed to
+# .RamFunc.*, which the STM32 linker script places in .data: they are copied
+# to SRAM at boot and ld adds long-branch veneers for calls to and from flash.
+#
+# The affected sources are built without LTO so the sections exist in the
+# object file. uni_build_report.py lists what was relocated.
+#
+import pioutil
+if pioutil.is_pio_build():
+
+    import struct, subprocess
+    from fnmatch import fnmatch
+    Import("env")
+
+    patterns = env.GetProjectOption("custom_uni_ramfunc", "").split()
+    sources = env.GetProjectOption("custom_uni_ramfunc_sources", "").split()
+
+    def elf_sections(path):
+        """Section names of an ELF32 little-endian object file."""
+        data = open(path, 'rb').read()
+        shoff, = struct.unpack_from('<I', data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x2E)
+        strtab_off, = struct.unpack_from('<I', data, shoff + shstrndx * shentsize + 0x10)
+        names = []
+        for i in range(shnum):
+            name_off, = struct.unpack_from('<I', data, shoff + i * shentsize)
+            start = strtab_off + name_off
+            names.append(data[start:data.index(b'\0', start)].decode())
+        return names
+
+    def relocate(target, source, env):
+        objcopy = env.subst("$OBJCOPY")
+        for obj in target:
+            path = obj.get_abspath()
+            moved = [ s for s in elf_sections(path) if s.startswith('.text.') and any(fnmatch(s[6:], p) for p in patterns) ]
+            if not moved: continue
+            args = [ objcopy ]
+            for s in moved: args += [ '--rename-section', '%s=.RamFunc.%s' % (s, s[6:]) ]
+            subprocess.check_call(args + [ path ])
+
+    def ramfunc_object(env, node):
+        obj = env.Object(node, CCFLAGS=env["CCFLAGS"] + [ "-fno-lto" ])
+        env.AddPostAction(obj, relocate)
+        return obj
+
+    if patterns:
+        for src in sources:
+            env.AddBuildMiddleware(ramfunc_object, src)
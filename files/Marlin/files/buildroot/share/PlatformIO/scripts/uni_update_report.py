@@ -0,0 +1,58 @@
+#
+# uni_update_report.py
+# SD update plan for the STM32F401CCU6 UNI bootloader build
+#
+# Keeps the previous firmware.bin as firmware.cur in the build directory and,
+# once the new one is written, lists the application sectors whose CRC32
+# changed and the update time with the stock bootloader (erase everything)
+# against a differential update (changed sectors only). Copy both files to the
+# card to compare against what is really flashed with
+# buildroot/share/scripts/uni_fw_update.py, which also simulates power cuts.
+# Also writes firmware.uni, the compressed block container from uni_fw_pack.py,
+# for bootloaders that can stream it.
+#
+import pioutil
+if pioutil.is_pio_build():
+
+    import shutil, sys, zlib
+    from pathlib import Path
+    from types import SimpleNamespace
+    Import("env")
+
+    sys.path.insert(0, str(Path(env.subst("$PROJECT_DIR"), "buildroot/share/scripts")))
+    from uni_fw_update import FLASH_BASE, FLASH_SIZE, Timing, app_sectors, pad, plan, program_words, sector_crcs
+    from uni_fw_pack import pack
+
+    bin_path = Path(env.subst("$BUILD_DIR"), env.subst("${PROGNAME}.bin"))
+    cur_path = bin_path.with_suffix(".cur")
+    uni_path = bin_path.with_suffix(".uni")
+
+    def keep_previous(source, target, env):
+        if bin_path.exists(): shutil.copyfile(bin_path, cur_path)
+
+    def report(source, target, env):
+        offset = int(env.BoardConfig().get("build.offset", "0"), 16)
+        sectors, region = app_sectors(offset), FLASH_SIZE - offset
+        new = bin_path.read_bytes()
+        image = pad(new, region)
+        timing = Timing(SimpleNamespace(t_word=16e-6, t_erase16=0.25, t_erase64=0.55, t_erase128=1.0, crc_mbs=40))
+
+        print("\nSTM32F401CCU6_UNI SD update (%s), firmware.bin CRC32 %08X" % (env.subst("$PIOENV"), zlib.crc32(new)))
+        uni_path.write_bytes(pack(new, 0x4000))
+        print("  %s: %d bytes, %.1f%% of firmware.bin" % (uni_path.name, uni_path.stat().st_size, 100.0 * uni_path.stat().st_size / len(new)))
+        if not cur_path.exists():
+            print("  No previous build to compare with")
+            return
+        flash = pad(cur_path.read_bytes()[:region], region)
+        have, want = sector_crcs(flash, sectors), sector_crcs(image, sectors)
+        for (s, n), a, b in zip(sectors, have, want):
+            print("  0x%08X %4dK  %08X  %s" % (FLASH_BASE + offset + s, n // 1024, b, "unchanged" if a == b else "changed"))
+        full = sum(timing.erase(n) for _, n in sectors) + timing.program(len(new))
+        diff = timing.crc(region)
+        for op in plan("diff", flash, image, sectors):
+            s, n = sectors[op[1]]
+            diff += timing.erase(n) if op[0] == "erase" else timing.words(program_words(image[s:s + n])) + timing.crc(n)
+        print("  Flash time: %.2f s full, %.2f s differential" % (full, diff))
+
+    env.AddPreAction("$BUILD_DIR/${PROGNAME}.bin", keep_previous)
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", report)
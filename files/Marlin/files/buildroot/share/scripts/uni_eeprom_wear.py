@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""
+uni_eeprom_wear.py
+
+Flash EEPROM emulation model for the STM32F401CCU6 UNI.
+
+Models Marlin's FLASH_EEPROM_LEVELING on the STM32: every M500 programs one
+MARLIN_EEPROM_SIZE slot in FLASH_SECTOR, and the sector is erased only when
+no blank slot is left. For each slot size the report shows the M500 latency
+(average and worst case), write amplification, sector erases and the time
+during which a power loss would lose the settings (after the erase, before
+the new slot is programmed).
+
+Timings default to the STM32F401 datasheet typical values at 2.7-3.6 V
+(x32 parallelism): 16 us per word, 250 ms per 16K sector erase.
+
+Usage: uni_eeprom_wear.py [--settings 700] [--changed 16] [--saves 10000]
+"""
+
+import argparse
+
+def simulate(slot, sector, settings, changed, saves, t_word, t_erase):
+    slots = sector // slot
+    used = erases = 0
+    total = worst = at_risk = 0.0
+    for _ in range(saves):
+        t = 0.0
+        if used == slots:
+            t += t_erase
+            erases += 1
+            used = 0
+            at_risk += t_erase
+        program = slot // 4 * t_word
+        if t: at_risk += program
+        t += program
+        used += 1
+        total += t
+        worst = max(worst, t)
+    return {
+        'slots': slots, 'avg': total / saves, 'worst': worst,
+        'wa': slot / changed, 'erases': erases, 'at_risk': at_risk,
+        'fits': settings <= slot,
+    }
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('--sector', type=lambda v: int(v, 0), default=0x4000, help='FLASH_UNIT_SIZE')
+    ap.add_argument('--settings', type=int, default=700, help='bytes of SettingsData actually stored')
+    ap.add_argument('--changed', type=int, default=16, help='bytes that change per M500')
+    ap.add_argument('--saves', type=int, default=10000)
+    ap.add_argument('--t-word', type=float, default=16e-6, help='word program time (s)')
+    ap.add_argument('--t-erase', type=float, default=0.25, help='sector erase time (s)')
+    ap.add_argument('--endurance', type=int, default=10000, help='erase cycles per sector')
+    args = ap.parse_args()
+
+    print('%-20s %6s %10s %10s %8s %8s %12s %10s' % (
+        'MARLIN_EEPROM_SIZE', 'Slots', 'Avg (ms)', 'Max (ms)', 'WA', 'Erases', 'Life (saves)', 'At risk'))
+    slot = 0x400
+    while slot <= args.sector:
+        r = simulate(slot, args.sector, args.settings, args.changed, args.saves, args.t_word, args.t_erase)
+        print('%-20s %6d %10.2f %10.2f %8.0f %8d %12d %9.1fs%s' % (
+            '0x%X' % slot, r['slots'], 1000 * r['avg'], 1000 * r['worst'], r['wa'], r['erases'],
+            r['slots'] * args.endurance, r['at_risk'], '' if r['fits'] else '  (settings do not fit)'))
+        slot *= 2
+
+if __name__ == '__main__':
+    main()
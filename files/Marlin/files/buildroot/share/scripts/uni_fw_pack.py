@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+uni_fw_pack.py
+
+Compressed firmware container for the STM32F401CCU6 UNI SD bootloader.
+
+Packs firmware.bin into firmware.uni: a header followed by independent
+blocks of --block bytes of the image, each raw-deflate compressed (stored as
+is when that doesn't help) and carrying the CRC32 of its uncompressed data.
+A bootloader can inflate one block at a time into the buffer it programs
+from, so it needs no more RAM than the block and the inflate state, checks
+every block before it is programmed and can resume at any block boundary.
+
+  header  'UNIZ', version, log2(block), 2 reserved bytes, image size,
+          image CRC32, block count, CRC32 of the preceding 20 bytes
+  block   uint32 length (bit 31 set when stored), uint32 CRC32, data
+
+The container is verified by streaming it back through the same block
+decoder. The benchmark then compares flashing firmware.bin with flashing
+firmware.uni at several SD read speeds: card read, inflate and CRC32 on the
+CPU, and the erase and word program times of the F401 (see uni_fw_update.py).
+
+BOOTLOADER_F401CC_UNI_SPI_SD.hex only loads 0:/firmware.bin, so a bootloader
+with the block decoder is needed to use the container.
+
+Usage: uni_fw_pack.py [--block 16384] [-o firmware.uni] firmware.bin
+       uni_fw_pack.py --verify firmware.uni
+"""
+
+import argparse, struct, zlib
+from pathlib import Path
+from uni_fw_update import FLASH_SIZE, Timing, app_sectors, program_words
+
+MAGIC = b'UNIZ'
+VERSION = 1
+HEADER = struct.Struct('<4sBBHIII')
+BLOCK = struct.Struct('<II')
+STORED = 0x80000000
+
+def window(block):
+    return max(9, min(15, block.bit_length() - 1))
+
+def pack(image, block):
+    shift = block.bit_length() - 1
+    if block != 1 << shift: raise SystemExit('--block must be a power of two')
+    count = -(-len(image) // block)
+    head = HEADER.pack(MAGIC, VERSION, shift, 0, len(image), zlib.crc32(image), count)
+    out = bytearray(head + struct.pack('<I', zlib.crc32(head)))
+    for a in range(0, len(image), block):
+        raw = image[a:a + block]
+        c = zlib.compressobj(9, zlib.DEFLATED, -window(block), 9)
+        data = c.compress(raw) + c.flush()
+        length = len(data)
+        if length >= len(raw): data, length = raw, len(raw) | STORED
+        out += BLOCK.pack(length, zlib.crc32(raw)) + data
+    return bytes(out)
+
+def blocks(container):
+    """Decode a container block by block, as a bootloader would. Yields (uncompressed block, bytes read)."""
+    head = container[:HEADER.size]
+    magic, version, shift, _, size, crc, count = HEADER.unpack(head)
+    if magic != MAGIC or version != VERSION: raise ValueError('not a firmware container')
+    if struct.unpack_from('<I', container, HEADER.size)[0] != zlib.crc32(head): raise ValueError('header CRC mismatch')
+    block, pos, total = 1 << shift, HEADER.size + 4, zlib.crc32(b'')
+    for i in range(count):
+        length, bcrc = BLOCK.unpack_from(container, pos)
+        pos += BLOCK.size
+        data = container[pos:pos + (length & ~STORED)]
+        pos += length & ~STORED
+        raw = data if length & STORED else zlib.decompressobj(-window(block)).decompress(data, block)
+        want = min(block, size - i * block)
+        if len(raw) != want or zlib.crc32(raw) != bcrc: raise ValueError('block %d CRC mismatch' % i)
+        total = zlib.crc32(raw, total)
+        yield raw, BLOCK.size + (length & ~STORED)
+    if total != crc: raise ValueError('image CRC mismatch')
+
+def flash_time(image, offset, timing):
+    """Erase every application sector the image touches, then program its non-blank words."""
+    t = 0.0
+    for s, n in app_sectors(offset):
+        if s < len(image): t += timing.erase(n) + timing.words(program_words(image[s:s + n]))
+    return t
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('input', help='firmware.bin to pack, or firmware.uni with --verify')
+    ap.add_argument('-o', '--output', help='container to write (default: input with .uni suffix)')
+    ap.add_argument('--verify', action='store_true', help='only check a container')
+    ap.add_argument('--block', type=int, default=16384, help='uncompressed bytes per block')
+    ap.add_argument('--offset', type=lambda v: int(v, 0), default=0x8000, help='board_build.offset')
+    ap.add_argument('--sd-kbs', default='150,300,600,1200', help='SD read speeds to compare (kB/s)')
+    ap.add_argument('--inflate-mbs', type=float, default=4, help='inflate speed on the F401 (MB/s of output)')
+    ap.add_argument('--crc-mbs', type=float, default=40, help='CRC32 speed (MB/s)')
+    ap.add_argument('--t-word', type=float, default=16e-6, help='word program time (s)')
+    ap.add_argument('--t-erase16', type=float, default=0.25, help='16K sector erase time (s)')
+    ap.add_argument('--t-erase64', type=float, default=0.55, help='64K sector erase time (s)')
+    ap.add_argument('--t-erase128', type=float, default=1.0, help='128K sector erase time (s)')
+    args = ap.parse_args()
+
+    data = Path(args.input).read_bytes()
+    if args.verify:
+        try:
+            size = sum(len(raw) for raw, _ in blocks(data))
+        except (ValueError, struct.error, zlib.error) as e:
+            raise SystemExit('%s: %s' % (args.input, e))
+        print('%s: %d blocks, %d bytes, all CRC32 match' % (args.input, HEADER.unpack_from(data)[6], size))
+        return
+
+    if len(data) > FLASH_SIZE - args.offset: raise SystemExit('%s: does not fit after offset 0x%X' % (args.input, args.offset))
+    container = pack(data, args.block)
+    if b''.join(raw for raw, _ in blocks(container)) != data: raise SystemExit('round trip failed')
+    out = Path(args.output or Path(args.input).with_suffix('.uni'))
+    out.write_bytes(container)
+    print('%s: %d bytes -> %s: %d bytes (%.1f%%), %d blocks of %d, largest block read %d bytes' % (args.input, len(data), out,
+        len(container), 100.0 * len(container) / len(data), -(-len(data) // args.block), args.block,
+        max(n for _, n in blocks(container))))
+
+    timing = Timing(args)
+    program = flash_time(data, args.offset, timing)
+    cpu = len(data) / (args.inflate_mbs * 1e6) + timing.crc(len(data))
+    print('Erase and program %.2f s, inflate and CRC32 %.2f s' % (program, cpu))
+    print('%8s %10s %10s %8s' % ('SD kB/s', 'Raw .bin', '.uni', 'Saved'))
+    for kbs in (float(v) for v in args.sd_kbs.split(',')):
+        raw = len(data) / (kbs * 1000) + program
+        packed = len(container) / (kbs * 1000) + cpu + program
+        print('%8.0f %9.2fs %9.2fs %7.2fs' % (kbs, raw, packed, raw - packed))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+uni_fw_update.py
+
+Differential firmware update planner for the STM32F401CCU6 UNI SPI-SD bootloader.
+
+BOOTLOADER_F401CC_UNI_SPI_SD.hex sits in sector 0 and, when it finds
+0:/firmware.bin on the card, erases the application sectors from
+board_build.offset (0x8000) up, programs the file, and renames it to
+0:/firmware.cur. Sector 1 is left to FLASH_EEPROM_EMULATION. The card thus
+holds two firmware banks: the new image until it is flashed, and the running
+one afterwards.
+
+Compares a new firmware.bin with the current image (firmware.cur, the
+previous build, or a full 256K flash dump) over the F401 sector map, gives
+the CRC32 of every application sector and says which ones must be erased and
+programmed. Three update strategies are timed and then interrupted at every
+erase and every --chunk bytes of programming:
+
+  full      the stock bootloader: erase every application sector, program
+            the whole file.
+  diff      skip sectors whose CRC32 already matches the new image, erase
+            and program the rest, CRC32-verify each one after programming.
+  diff-safe as diff, but the vector table sector (0x08008000) is always
+            erased first and programmed last, so a half-written application
+            never has a valid stack pointer and reset vector.
+
+After a cut the next boot either finds firmware.bin still on the card and
+runs the same update again from whatever is in flash, or, with the card
+pulled, jumps to the application if its vector table looks valid. The report
+gives the time to resume and the cut points where the printer would boot a
+mix of old and new code.
+
+Timings default to the STM32F401 datasheet typical values at 2.7-3.6 V
+(x32 parallelism): 16 us per word, 250/550/1000 ms per 16K/64K/128K erase.
+
+Usage: uni_fw_update.py [--offset 0x8000] [--chunk 1024] current.bin firmware.bin
+"""
+
+import argparse, random, struct, zlib
+from pathlib import Path
+
+FLASH_BASE = 0x08000000
+SECTORS = [ (0x0000, 0x4000), (0x4000, 0x4000), (0x8000, 0x4000), (0xC000, 0x4000), (0x10000, 0x10000), (0x20000, 0x20000) ]
+FLASH_SIZE = 0x40000
+SRAM = (0x20000000, 0x20010000)
+
+def app_sectors(offset):
+    return [ (start - offset, size) for start, size in SECTORS if start >= offset ]
+
+def pad(image, size):
+    return bytes(image) + b'\xff' * (size - len(image))
+
+def sector_crcs(flash, sectors):
+    return [ zlib.crc32(flash[s:s + n]) for s, n in sectors ]
+
+def program_words(block):
+    """Words that differ from the erased state, the only ones a program pass has to touch."""
+    return sum(1 for i in range(0, len(block), 4) if block[i:i + 4] != b'\xff\xff\xff\xff')
+
+class Timing:
+    def __init__(self, args):
+        self.args = args
+
+    def erase(self, size):
+        return { 0x4000: self.args.t_erase16, 0x10000: self.args.t_erase64, 0x20000: self.args.t_erase128 }[size]
+
+    def program(self, nbytes):
+        return nbytes // 4 * self.args.t_word
+
+    def words(self, n):
+        return n * self.args.t_word
+
+    def crc(self, nbytes):
+        return nbytes / (self.args.crc_mbs * 1e6)
+
+def plan(strategy, flash, image, sectors):
+    """Sector operations an update runs from the given flash contents: ('erase', i) and ('program', i[, 'vectors last'])."""
+    ops, want = [], sector_crcs(image, sectors)
+    todo = list(range(len(sectors)))
+    if strategy != 'full':
+        have = sector_crcs(flash, sectors)
+        todo = [ i for i in todo if have[i] != want[i] ]
+    if strategy == 'diff-safe' and todo and todo[0]: todo.insert(0, 0)
+    if strategy == 'full':
+        ops += [ ('erase', i) for i in todo ]
+    for i in todo:
+        if strategy != 'full': ops.append(('erase', i))
+        if strategy == 'diff-safe' and i == 0: continue
+        ops.append(('program', i))
+    if strategy == 'diff-safe' and todo: ops.append(('program', 0, 'vectors last'))   # Sector 0 was erased above
+    return ops
+
+def expand(ops, image, sectors, chunk):
+    """Split program operations into --chunk pieces, skipping pieces that are all 0xFF."""
+    out = []
+    for op in ops:
+        if op[0] == 'erase':
+            out.append(op)
+            continue
+        s, n = sectors[op[1]]
+        pieces = [ (a, a + chunk) for a in range(s, s + n, chunk) ]
+        if len(op) > 2: pieces = [ (8, chunk) ] + pieces[1:] + [ (0, 8) ]  # Stack pointer and reset vector commit the image
+        out += [ ('program', op[1], a, b) for a, b in pieces if image[a:b] != b'\xff' * (b - a) ]
+        out.append(('verify', op[1]))
+    return out
+
+def run(ops, flash, image, sectors, timing, limit=None, rng=None, full_program=False):
+    """Apply ops to flash, stopping partway through op number 'limit'. Returns the time taken."""
+    t = 0.0
+    for k, op in enumerate(ops):
+        cut = k == limit
+        if op[0] == 'erase':
+            s, n = sectors[op[1]]
+            flash[s:s + n] = rng.randbytes(n) if cut else b'\xff' * n
+            t += timing.erase(n)
+        elif op[0] == 'program':
+            a, b = op[2], op[3]
+            if cut: b = a + (b - a) // 2
+            block = image[a:b]
+            flash[a:b] = bytes(x & y for x, y in zip(flash[a:b], block))
+            t += timing.program(b - a) if full_program else timing.words(program_words(block))
+        else:
+            s, n = sectors[op[1]]
+            t += timing.crc(n)
+        if cut: break
+    return t
+
+def bootable(flash):
+    sp, reset = struct.unpack_from('<II', flash, 0)
+    return SRAM[0] <= sp <= SRAM[1] and FLASH_BASE <= reset < FLASH_BASE + FLASH_SIZE
+
+def update(strategy, flash, image, sectors, timing, args, limit=None, rng=None):
+    """One boot with firmware.bin on the card. Returns (time, ops run)."""
+    ops = expand(plan(strategy, flash, image, sectors), image, sectors, args.chunk)
+    t = timing.crc(len(image)) if strategy != 'full' else 0.0     # CRC of the current sectors
+    t += len(image) / (args.sd_kbs * 1000)                          # firmware.bin off the card
+    return t + run(ops, flash, image, sectors, timing, limit, rng, strategy == 'full'), ops
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('current', help='running firmware: firmware.cur, previous build, or a 256K flash dump')
+    ap.add_argument('new', help='new firmware.bin')
+    ap.add_argument('--offset', type=lambda v: int(v, 0), default=0x8000, help='board_build.offset')
+    ap.add_argument('--chunk', type=int, default=1024, help='bytes programmed between power-cut points')
+    ap.add_argument('--t-word', type=float, default=16e-6, help='word program time (s)')
+    ap.add_argument('--t-erase16', type=float, default=0.25, help='16K sector erase time (s)')
+    ap.add_argument('--t-erase64', type=float, default=0.55, help='64K sector erase time (s)')
+    ap.add_argument('--t-erase128', type=float, default=1.0, help='128K sector erase time (s)')
+    ap.add_argument('--crc-mbs', type=float, default=40, help='CRC32 of flash contents (MB/s)')
+    ap.add_argument('--sd-kbs', type=float, default=600, help='firmware.bin read speed off the card (kB/s)')
+    ap.add_argument('--seed', type=int, default=1)
+    args = ap.parse_args()
+
+    sectors = app_sectors(args.offset)
+    region = FLASH_SIZE - args.offset
+    current, new = Path(args.current).read_bytes(), Path(args.new).read_bytes()
+    if len(current) == FLASH_SIZE: current = current[args.offset:]
+    for name, data in ((args.current, current), (args.new, new)):
+        if len(data) > region: raise SystemExit('%s: %d bytes does not fit the %dK after offset 0x%X' % (name, len(data), region // 1024, args.offset))
+    flash, image = pad(current, region), pad(new, region)
+    if not bootable(image): raise SystemExit('%s: no valid vector table at offset 0' % args.new)
+    timing, rng = Timing(args), random.Random(args.seed)
+
+    print('Application 0x%08X-0x%08X, %d bytes -> %d bytes' % (FLASH_BASE + args.offset, FLASH_BASE + FLASH_SIZE - 1, len(current), len(new)))
+    print('%-11s %7s %10s %10s  %s' % ('Address', 'Size', 'CRC32 now', 'CRC32 new', 'Action'))
+    have, want = sector_crcs(flash, sectors), sector_crcs(image, sectors)
+    for (s, n), a, b in zip(sectors, have, want):
+        print('0x%08X %6dK   %08X   %08X  %s' % (FLASH_BASE + args.offset + s, n // 1024, a, b,
+            'keep' if a == b else 'erase + program %d bytes' % (program_words(image[s:s + n]) * 4)))
+
+    print()
+    print('%-9s %7s %11s %9s %11s %10s %13s %12s' % ('Strategy', 'Erased', 'Programmed', 'Time', 'Cut points',
+        'Recovered', 'Resume (avg)', 'Mixed boots'))
+    base = None
+    for strategy in ('full', 'diff', 'diff-safe'):
+        t, ops = update(strategy, bytearray(flash), image, sectors, timing, args)
+        erased = sum(sectors[op[1]][1] for op in ops if op[0] == 'erase')
+        programmed = sum(op[3] - op[2] for op in ops if op[0] == 'program')
+        recovered = mixed = 0
+        resume = 0.0
+        for cut in range(len(ops)):
+            if ops[cut][0] == 'verify': continue
+            after = bytearray(flash)
+            update(strategy, after, image, sectors, timing, args, cut, rng)
+            if after != flash and after != image and bootable(after): mixed += 1
+            r, _ = update(strategy, after, image, sectors, timing, args)
+            resume += r
+            recovered += after == image
+        cuts = sum(1 for op in ops if op[0] != 'verify')
+        base = base or t
+        print('%-9s %6dK %10dK %8.2fs %11d %9.1f%% %12.2fs %12d%s' % (strategy, erased // 1024, programmed // 1024, t, cuts,
+            100.0 * recovered / cuts if cuts else 100.0, resume / cuts if cuts else 0.0, mixed,
+            '' if t == base else '   %.2f s saved' % (base - t)))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+uni_gcode_compact.py
+
+Shrink a G-code file for USB streaming to the STM32F401CCU6 UNI.
+
+Strips comments and blank lines, drops coordinates and feedrates that repeat
+the modal state, and rounds each axis to the resolution its steps/mm can
+actually reach. Fewer bytes per command means less time in Marlin's parser
+and on the wire. In relative mode (G91, M83) the rounding remainder is
+carried into the next word of the same axis, so tiny moves are merged
+rather than dropped and the rounding error never builds up.
+
+--bench streams the motion lines of the original and the compacted job to
+the board as G4 with the same words (S and P renamed to Q so no dwell is
+set): Marlin reads and parses every word, then plans nothing. The command
+queue is kept full with ADVANCED_OK credits, so the rate is set by the main
+loop. Per job it reports commands per second, the firmware time per command
+above a bare 'G4' (the parse cost), and the host CPU time per line and load
+while streaming. Requires pyserial.
+
+Usage: uni_gcode_compact.py [--config Marlin] in.gcode out.gcode
+       uni_gcode_compact.py --bench --port /dev/ttyACM0 in.gcode out.gcode
+"""
+
+import argparse, math, re, time
+from pathlib import Path
+from uni_step_rate import config_array
+
+AXES = 'XYZE'
+MOTION = ('G0', 'G1', 'G2', 'G3')
+FORGET = ('G28', 'G29', 'G30', 'M600')   # Move or re-zero axes unseen, like G53-G59.x and G92.x
+
+def fmt(value, decimals):
+    s = ('%.*f' % (decimals, value)).rstrip('0').rstrip('.') if decimals else '%d' % round(value)
+    return '0' if s in ('-0', '') else s
+
+def compact(lines, decimals):
+    pos = dict.fromkeys(AXES)
+    carry = dict.fromkeys(AXES, 0.0)      # Rounding remainder of relative words not yet sent
+    feed, absolute, e_absolute = None, True, True
+    for raw in lines:
+        line = raw.split(';', 1)[0].strip()
+        if not line: continue
+        words = re.findall(r'([A-Za-z])\s*([-+]?[0-9.]*)', line)
+        if not words:
+            yield line
+            continue
+        cmd = (words[0][0] + words[0][1]).upper().replace('G00', 'G0').replace('G01', 'G1').replace('G02', 'G2').replace('G03', 'G3')
+        if cmd in ('G90', 'G91'): absolute = e_absolute = cmd == 'G90'
+        elif cmd in ('M82', 'M83'): e_absolute = cmd == 'M82'
+        if cmd in ('G90', 'M82'):
+            for k in (AXES if cmd == 'G90' else 'E'): carry[k] = 0.0
+        elif cmd == 'G92':
+            for k, v in words[1:]:
+                if k.upper() in AXES: pos[k.upper()] = float(v or 0)
+        elif cmd in FORGET or re.match(r'G(5[3-9]|92)(\.|$)', cmd): pos = dict.fromkeys(AXES)
+        if cmd not in MOTION:
+            yield line
+            continue
+        out = [cmd]
+        for k, v in words[1:]:
+            k = k.upper()
+            if not v: continue
+            val = float(v)
+            if k in AXES:
+                rel = not (e_absolute if k == 'E' else absolute)
+                if rel:
+                    want = val + carry[k]
+                    val = float(fmt(want, decimals[k]))
+                    carry[k] = want - val
+                    if val == 0: continue
+                    if pos[k] is not None: pos[k] += val
+                else:
+                    val = float(fmt(val, decimals[k]))
+                    if pos[k] == val and cmd in ('G0', 'G1'): continue
+                    pos[k] = val
+                out.append(k + fmt(val, decimals[k]))
+            elif k == 'F':
+                if val == feed: continue
+                feed = val
+                out.append('F' + fmt(val, 0))
+            elif k in 'IJ':
+                out.append(k + fmt(val, decimals['X']))
+            else:
+                out.append(k + v)
+        if len(out) > 1: yield ' '.join(out)
+
+def probe(lines):
+    """The motion lines as G4 with the same words: parsed in full, nothing planned."""
+    for line in lines:
+        m = re.match(r'^[Gg]0*[0-3](?![0-9.])\s*(.*)$', line)
+        if m: yield ('G4 ' + re.sub(r'[PpSs](?=[-+.0-9])', 'Q', m.group(1))).strip()
+
+def bench(args, jobs):
+    """Stream the probe of each job and a bare G4 stream; print firmware and host cost per command."""
+    import serial
+    from uni_stream import Stats, stream_credit, wait_ok
+
+    with serial.Serial(args.port, args.baud, timeout=10) as port:
+        time.sleep(2)
+        port.reset_input_buffer()
+        port.write(b'M110 N0\n')
+        stats = Stats()
+        capacity = stats.advanced_ok(wait_ok(port, stats))
+        if not capacity: raise SystemExit('--bench needs ADVANCED_OK enabled in the firmware')
+
+        def run(lines):
+            wall, cpu = time.perf_counter(), time.process_time()
+            stream_credit(port, lines, False, Stats(), args.rx_bytes, capacity)
+            return time.perf_counter() - wall, time.process_time() - cpu
+
+        probes = [ (name, list(probe(lines)), prep) for name, lines, prep in jobs ]
+        count = max(len(p) for _, p, _ in probes)
+        floor = run([ 'G4' ] * count)[0] / count if count else 0.0
+        print('Bare G4: %.0f commands/s, %.1f us each' % (1 / floor if floor else 0, 1e6 * floor))
+        print('%-10s %9s %10s %12s %14s %12s %10s %12s' % ('Job', 'Commands', 'Bytes/cmd', 'Commands/s',
+            'Parse us/cmd', 'Host us/cmd', 'Host CPU', 'Prepare us'))
+        for name, lines, prep in probes:
+            if not lines: continue
+            wall, cpu = run(lines)
+            print('%-10s %9d %10.1f %12.0f %14.1f %12.1f %9.1f%% %12.2f' % (name, len(lines),
+                sum(len(l) + 1 for l in lines) / len(lines), len(lines) / wall, 1e6 * (wall / len(lines) - floor),
+                1e6 * cpu / len(lines), 100 * cpu / wall, 1e6 * prep / len(lines)))
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('input')
+    ap.add_argument('output')
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h')
+    ap.add_argument('--bench', action='store_true', help='measure parse and host cost of both files on the board')
+    ap.add_argument('--port', help='serial port for --bench')
+    ap.add_argument('--baud', type=int, default=250000)
+    ap.add_argument('--rx-bytes', type=int, default=127, help='bytes allowed in flight while benchmarking')
+    args = ap.parse_args()
+    if args.bench and not args.port: ap.error('--bench needs --port')
+
+    text = Path(args.config, 'Configuration.h').read_text(errors='ignore')
+    steps = config_array(text, 'DEFAULT_AXIS_STEPS_PER_UNIT')[:4]
+    decimals = { a: max(0, math.ceil(math.log10(s))) for a, s in zip(AXES, steps) }
+
+    src = Path(args.input).read_text(errors='ignore').splitlines()
+    cpu = time.process_time()
+    out = list(compact(src, decimals))
+    cpu = time.process_time() - cpu
+    Path(args.output).write_text('\n'.join(out) + '\n')
+
+    before = sum(len(l) + 1 for l in src)
+    after = sum(len(l) + 1 for l in out)
+    print('%d -> %d lines, %d -> %d bytes (%.1f%%), %.1f bytes/line' % (
+        len(src), len(out), before, after, 100.0 * after / before if before else 0, after / len(out) if out else 0))
+
+    if args.bench:
+        original = [ l for l in (r.split(';', 1)[0].strip() for r in src) if l ]
+        bench(args, [ ('original', original, 0.0), ('compacted', out, cpu) ])
+
+if __name__ == '__main__':
+    main()
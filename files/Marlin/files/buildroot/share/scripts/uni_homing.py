@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""
+uni_homing.py
+
+Homing time and repeatability model for the STM32F401CCU6 UNI.
+
+Simulates G28 on each axis with the homing settings in Marlin/Configuration.h
+and Configuration_adv.h: the first pass at HOMING_FEEDRATE_MM_M, the retract
+by HOMING_BUMP_MM and the second approach at the feedrate divided by
+HOMING_BUMP_DIVISOR. Every trigger reaches the firmware after the UNI
+optocoupler delay plus its jitter and, unless ENDSTOP_INTERRUPTS_FEATURE is
+set, a wait for the next 1 kHz endstop poll. The axis stops on the next step
+after that, so the home position lands at the switch point plus feedrate x
+delay, rounded up to a whole step.
+
+The latency is measured the way it would be on the printer. The difference
+between the first-pass and second-pass stop positions divided by the
+difference in feedrates gives the fixed delay. A single fast pass is then
+modeled with that delay subtracted at the first-pass feedrate, and its time
+and repeatability are compared with the two-stage bump. When the estimate is
+not positive or lies within two standard errors of zero (the step size and
+switch noise swamp the delay) it is reported as n/a and nothing is
+compensated. XY homing is also
+timed with and without QUICK_HOME (diagonal first move).
+
+Usage: uni_homing.py [--latency-us 100] [--jitter-us 10] [--switch-um 5] [--polled|--interrupts]
+"""
+
+import argparse, ast, math, operator, random, re, statistics
+from pathlib import Path
+from uni_step_rate import config_array, config_value
+
+AXES = 'XYZ'
+OPS = { ast.Add: operator.add, ast.Sub: operator.sub, ast.Mult: operator.mul, ast.Div: operator.truediv,
+        ast.UAdd: operator.pos, ast.USub: operator.neg }
+
+def constant(expr):
+    """Value of a constant C expression like (50*60): numbers, + - * / and parentheses only."""
+    def value(node):
+        if isinstance(node, ast.Constant) and type(node.value) in (int, float): return node.value
+        if isinstance(node, ast.BinOp) and type(node.op) in OPS: return OPS[type(node.op)](value(node.left), value(node.right))
+        if isinstance(node, ast.UnaryOp) and type(node.op) in OPS: return OPS[type(node.op)](value(node.operand))
+        raise SystemExit('Not a constant expression: %s' % expr)
+    try:
+        return float(value(ast.parse(re.sub(r'(?<=[0-9.])[fF]\b', '', expr.strip()), mode='eval').body))
+    except SyntaxError:
+        raise SystemExit('Not a constant expression: %s' % expr)
+
+def reach_time(d, v, a):
+    """Time to cover d from rest at feedrate v and acceleration a, ending at speed (abrupt endstop stop)."""
+    ramp = v * v / (2 * a)
+    return d / v + v / (2 * a) if d > ramp else math.sqrt(2 * d / a)
+
+def move_time(d, v, a):
+    """Time for a full trapezoid move of length d."""
+    return d / v + v / a if d > v * v / a else 2 * math.sqrt(d / a)
+
+class Axis:
+    def __init__(self, length, feedrate, accel, bump, divisor, steps_per_mm):
+        self.length, self.v1, self.a = length, feedrate, accel
+        self.bump, self.v2 = bump, feedrate / divisor
+        self.step = 1.0 / steps_per_mm
+
+def stop_position(v, step, rng, args):
+    """Where the axis stops relative to the nominal switch point (mm), for one trigger at speed v."""
+    delay = (args.latency_us + rng.gauss(0, args.jitter_us)) * 1e-6
+    if args.polled: delay += rng.uniform(0, 1.0 / args.poll_hz)
+    pos = rng.gauss(0, args.switch_um * 1e-3) + v * delay
+    return math.ceil(pos / step) * step
+
+def home_axis(ax, start, rng, args, compensate=None):
+    """One homing of an axis from 'start' mm above the switch. Returns (seconds, final position, first-pass stop)."""
+    t = reach_time(start, ax.v1, ax.a)
+    first = stop_position(ax.v1, ax.step, rng, args)
+    if compensate is not None:
+        return t, first - ax.v1 * compensate, first
+    if not ax.bump:
+        return t, first, first
+    t += move_time(ax.bump, ax.v1, ax.a) + reach_time(ax.bump, ax.v2, ax.a)
+    second = stop_position(ax.v2, ax.step, rng, args)
+    return t, second, first
+
+def report(name, times, finals):
+    spread = max(finals) - min(finals)
+    print('  %-30s %7.2f s %9.1f um %9.1f um %9.1f um' % (name, statistics.mean(times),
+        1000 * statistics.mean(finals), 1000 * statistics.stdev(finals), 1000 * spread))
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h')
+    ap.add_argument('--latency-us', type=float, default=100, help='optocoupler propagation delay (us)')
+    ap.add_argument('--jitter-us', type=float, default=10, help='delay jitter (us RMS)')
+    ap.add_argument('--switch-um', type=float, default=5, help='switch trip point repeatability (um RMS)')
+    ap.add_argument('--poll-hz', type=float, default=1000, help='endstop poll rate without interrupts')
+    mode = ap.add_mutually_exclusive_group()
+    mode.add_argument('--polled', dest='polled', action='store_true', default=None)
+    mode.add_argument('--interrupts', dest='polled', action='store_false')
+    ap.add_argument('--trials', type=int, default=2000)
+    ap.add_argument('--calibrate', type=int, default=200, help='two-stage homings used to measure the latency')
+    ap.add_argument('--seed', type=int, default=1)
+    args = ap.parse_args()
+
+    text = ''.join(Path(args.config, f).read_text(errors='ignore') for f in ('Configuration.h', 'Configuration_adv.h'))
+    if args.polled is None:
+        args.polled = config_value(text, 'ENDSTOP_INTERRUPTS_FEATURE') is None
+    feed = [ constant(x) / 60 for x in config_value(text, 'HOMING_FEEDRATE_MM_M').strip('{} ').split(',') ]
+    bump, divisor = config_array(text, 'HOMING_BUMP_MM'), config_array(text, 'HOMING_BUMP_DIVISOR')
+    accel, steps = config_array(text, 'DEFAULT_MAX_ACCELERATION'), config_array(text, 'DEFAULT_AXIS_STEPS_PER_UNIT')
+    length = [ float(config_value(text, n)) for n in ('X_BED_SIZE', 'Y_BED_SIZE', 'Z_MAX_POS') ]
+    axes = [ Axis(length[i], feed[i], accel[i], bump[i], divisor[i], steps[i]) for i in range(3) ]
+    rng = random.Random(args.seed)
+
+    print('Endstops %s, latency %.0f us ± %.1f us, switch ± %.1f um. Positions relative to the switch point.' % (
+        'polled at %.0f Hz' % args.poll_hz if args.polled else 'on EXTI', args.latency_us, args.jitter_us, args.switch_um))
+    print('  %-30s %9s %12s %12s %12s' % ('', 'Time', 'Mean', 'Sigma', 'Range'))
+    for name, ax in zip(AXES, axes):
+        # Measure the fixed delay from a few ordinary two-stage homings
+        measured, latency = None, 'n/a (no second bump)'
+        if ax.bump and ax.v1 != ax.v2:
+            samples = [ home_axis(ax, ax.length / 2, rng, args) for _ in range(args.calibrate) ]
+            estimates = [ (first - second) / (ax.v1 - ax.v2) for _, second, first in samples ]
+            estimate = statistics.mean(estimates)
+            error = statistics.stdev(estimates) / math.sqrt(len(estimates))
+            latency = '%.0f ± %.0f us' % (estimate * 1e6, error * 1e6)
+            if estimate > 2 * error: measured = estimate
+            else: latency = 'n/a (%s, within noise)' % latency
+        print('%s: %.0f mm/s, bump %g mm at %.1f mm/s, %.1f um/step, measured latency %s' % (name, ax.v1, ax.bump, ax.v2,
+            1000 * ax.step, latency))
+        runs = [ home_axis(ax, rng.uniform(0, ax.length), rng, args) for _ in range(args.trials) ]
+        report('two-stage (configured)', [ r[0] for r in runs ], [ r[1] for r in runs ])
+        if measured is not None:
+            runs = [ home_axis(ax, rng.uniform(0, ax.length), rng, args, measured) for _ in range(args.trials) ]
+            report('single pass, compensated', [ r[0] for r in runs ], [ r[1] for r in runs ])
+
+    # XY: sequential first passes vs QUICK_HOME's diagonal, which stops when the first endstop triggers
+    x, y = axes[0], axes[1]
+    seq = quick = 0.0
+    for _ in range(args.trials):
+        sx, sy = rng.uniform(0, x.length), rng.uniform(0, y.length)
+        tx, ty = home_axis(x, sx, rng, args)[0], home_axis(y, sy, rng, args)[0]
+        seq += tx + ty
+        near = min(sx, sy)
+        diag = reach_time(near * math.sqrt(2), min(x.v1, y.v1) * math.sqrt(2), min(x.a, y.a))
+        quick += diag + tx - reach_time(sx, x.v1, x.a) + reach_time(max(sx - near, 1e-6), x.v1, x.a) \
+                      + ty - reach_time(sy, y.v1, y.a) + reach_time(max(sy - near, 1e-6), y.v1, y.a)
+    print('XY: %.2f s sequential, %.2f s with QUICK_HOME%s' % (seq / args.trials, quick / args.trials,
+        ' (enabled)' if config_value(text, 'QUICK_HOME') is not None else ''))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""
+uni_laser.py
+
+Laser energy-per-mm model for the STM32F401CCU6 UNI TTL output.
+
+Plans a laser job with Marlin's trapezoids (DEFAULT_ACCELERATION, junction
+deviation, a full look-ahead) and integrates the power applied along the
+path in --bin mm steps for each way LASER_FEATURE can set it:
+
+  inline    'M3 I': the block's S, held for the whole block.
+  dynamic   'M4 I': power from the block's programmed feedrate (F >> 8),
+            whatever S is, held for the whole block.
+  trap      inline with LASER_POWER_TRAP: the planner sets the entry and
+            exit power from the speed over the nominal speed, and the
+            stepper ISR ramps linearly per step between them and S.
+  velocity  S scaled by the instantaneous speed over the nominal speed on
+            every step, in the stepper ISR.
+
+Trap and velocity apply whole PWM255 counts, as the PWM output does.
+
+Lines with axis words and no G word repeat the last G0-G3, as with
+GCODE_MOTION_MODES, and arcs are split into MAX_ARC_SEGMENT_MM chords, one
+block each.
+
+Energy per mm is compared with what the block would get at its nominal
+speed (S over the feedrate). For inline and dynamic it piles up where the
+head slows down: at the ends of raster lines and at corners. The report
+gives the worst over- and under-burn and the share of the burned length
+within --tolerance.
+
+Without a job, --raster WxH makes a bidirectional raster of W mm lines,
+H of them at 0.1 mm pitch, each split into 1 mm segments stepping from
+S20 to S255 and back.
+
+Usage: uni_laser.py [--config Marlin] [--raster 40x20] [--feed 6000] [job.gcode]
+"""
+
+import argparse, math, re
+from pathlib import Path
+from uni_step_rate import Modal, config_array, config_value, line_moves
+
+def raster(width, lines, feed):
+    """Bidirectional grayscale raster at 0.1 mm pitch, 1 mm segments with varying S."""
+    out = [ 'G0 X0 Y0', 'M3 I S0', 'G1 F%d' % feed ]
+    for k in range(lines):
+        xs = range(1, width + 1) if k % 2 == 0 else range(width - 1, -1, -1)
+        for x in xs:
+            s = 20 + abs((x * 47) % 470 - 235)
+            out.append('G1 X%d S%d' % (x, s))
+        out.append('G0 Y%.1f S0' % ((k + 1) * 0.1))
+    return out
+
+def blocks(lines, max_feed, arc_mm):
+    """[(length, unit, nominal mm/s, S, burning, F mm/min)] from G0-G3 lines with inline S, arcs split into chords."""
+    state, power, out = Modal(), 0.0, []
+    for raw in lines:
+        line = raw.split(';', 1)[0].strip().upper()
+        words = dict((w[0], float(w[1:])) for w in re.findall(r'[A-Z][-+]?[0-9.]+', line))
+        if 'S' in words: power = words['S']
+        if words.get('M') == 5: power = 0.0
+        for delta, feed in line_moves(line, state, arc_mm):
+            length = math.hypot(*delta[:2])
+            if not length: continue
+            unit = [ c / length for c in delta[:2] ]
+            nominal = min([ feed ] + [ max_feed[i] / abs(unit[i]) for i in range(2) if unit[i] ])
+            out.append((length, unit, nominal, power, state.motion != 0 and power > 0, feed * 60))
+    return out
+
+def plan(bl, accel, jd):
+    """Entry speed of each block plus the final exit (0), with junction deviation and full look-ahead."""
+    n = len(bl)
+    limit = [ 0.0 ] * (n + 1)
+    for i in range(1, n):
+        cos_theta = -sum(a * b for a, b in zip(bl[i - 1][1], bl[i][1]))
+        v = min(bl[i - 1][2], bl[i][2])
+        if cos_theta >= 0.999999: v = 0.0
+        elif cos_theta > -0.999999:
+            sin_theta_d2 = math.sqrt(0.5 * (1.0 - cos_theta))
+            v = min(v, math.sqrt(accel * jd * sin_theta_d2 / (1.0 - sin_theta_d2)))
+        limit[i] = v
+    for i in range(n - 1, -1, -1): limit[i] = min(limit[i], math.sqrt(limit[i + 1] ** 2 + 2 * accel * bl[i][0]))
+    for i in range(n): limit[i + 1] = min(limit[i + 1], math.sqrt(limit[i] ** 2 + 2 * accel * bl[i][0]))
+    return limit
+
+def ramps(length, v0, v1, nominal, accel):
+    """Accelerate and decelerate distances of a block's trapezoid (a triangle if it never cruises)."""
+    d_acc = (nominal * nominal - v0 * v0) / (2 * accel)
+    d_dec = (nominal * nominal - v1 * v1) / (2 * accel)
+    if d_acc + d_dec > length:
+        d_acc = max(0.0, min(length, (2 * accel * length + v1 * v1 - v0 * v0) / (4 * accel)))
+        d_dec = length - d_acc
+    return d_acc, d_dec
+
+def power(mode, s, x, v, block):
+    """Power applied at distance x into the block, moving at v."""
+    length, v0, v1, nominal, d_acc, d_dec, feed_mm_m = block
+    if mode == 'inline': return s
+    if mode == 'dynamic': return min(255, int(feed_mm_m) >> 8)
+    if mode == 'trap':
+        # Planner entry/exit power from the speed ratio, then a linear ramp per step to the full power
+        if x < d_acc: p = s * v0 / nominal + (s - s * v0 / nominal) * x / d_acc
+        elif x > length - d_dec: p = s - (s - s * v1 / nominal) * (x - length + d_dec) / d_dec
+        else: p = s
+        return math.floor(p)
+    return math.floor(s * min(1.0, v / nominal))
+
+def energy(bl, entry, mode, accel, step, binsize):
+    """Energy per mm relative to S / nominal speed, one value per burned bin."""
+    ratios = []
+    for (length, _, nominal, s, burning, feed_mm_m), v0, v1 in zip(bl, entry, entry[1:]):
+        if not burning: continue
+        want = s / nominal
+        n = max(1, int(round(length / step)))
+        ds = length / n
+        block = (length, v0, v1, nominal) + ramps(length, v0, v1, nominal, accel) + (feed_mm_m,)
+        acc, filled = 0.0, 0.0
+        for k in range(n):
+            x = (k + 0.5) * ds
+            v = min(nominal, math.sqrt(v0 * v0 + 2 * accel * x), math.sqrt(v1 * v1 + 2 * accel * (length - x)))
+            acc += power(mode, s, x, v, block) * ds / v
+            filled += ds
+            if filled >= binsize - 1e-9 or k == n - 1:
+                ratios.append((acc / filled / want, filled))
+                acc = filled = 0.0
+    return ratios
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('gcode', nargs='?')
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h')
+    ap.add_argument('--raster', default='40x20', help='test raster W (mm) x H (lines) when no job is given')
+    ap.add_argument('--feed', type=float, default=6000, help='raster feedrate (mm/min)')
+    ap.add_argument('--bin', type=float, default=0.1, help='length over which energy is summed (mm)')
+    ap.add_argument('--tolerance', type=float, default=0.05, help='energy error counted as uniform (fraction)')
+    args = ap.parse_args()
+
+    text = Path(args.config, 'Configuration.h').read_text(errors='ignore')
+    adv = Path(args.config, 'Configuration_adv.h').read_text(errors='ignore')
+    arc_mm = float(config_value(adv, 'MAX_ARC_SEGMENT_MM') or config_value(adv, 'MM_PER_ARC_SEGMENT') or 1.0)
+    max_feed = config_array(text, 'DEFAULT_MAX_FEEDRATE')[:2]
+    accel = float(config_value(text, 'DEFAULT_ACCELERATION').split()[0])
+    jd = float(config_value(text, 'JUNCTION_DEVIATION_MM').split()[0])
+    step = 1.0 / config_array(text, 'DEFAULT_AXIS_STEPS_PER_UNIT')[0]
+
+    if args.gcode:
+        lines = Path(args.gcode).read_text(errors='ignore').splitlines()
+    else:
+        w, h = (int(v) for v in args.raster.lower().split('x'))
+        lines = raster(w, h, args.feed)
+    bl = blocks(lines, max_feed, arc_mm)
+    entry = plan(bl, accel, jd)
+    burned = sum(b[0] for b in bl if b[4])
+    print('%d blocks, %.1f mm burned, acceleration %.0f mm/s², junction deviation %g mm, %.4f mm/step' % (
+        len(bl), burned, accel, jd, step))
+    print('%-8s %12s %12s %12s %16s' % ('Mode', 'Max E/mm', 'Min E/mm', 'RMS error', 'Within ±%.0f%%' % (100 * args.tolerance)))
+    for mode in ('inline', 'dynamic', 'trap', 'velocity'):
+        r = energy(bl, entry, mode, accel, step, args.bin)
+        total = sum(l for _, l in r)
+        rms = math.sqrt(sum((x - 1) ** 2 * l for x, l in r) / total)
+        ok = sum(l for x, l in r if abs(x - 1) <= args.tolerance)
+        print('%-8s %11.0f%% %11.0f%% %11.1f%% %15.1f%%' % (mode, 100 * max(x for x, _ in r), 100 * min(x for x, _ in r),
+            100 * rms, 100 * ok / total))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+uni_lookahead.py
+
+Planner look-ahead benchmark for the STM32F401CCU6 UNI.
+
+Replays a G-code file through a model of Marlin's planner (trapezoid blocks,
+junction deviation, and the rule that the last queued block must end at rest)
+and reports the average feedrate achieved with BLOCK_BUFFER_SIZE 16, 32 and 64.
+Short arc segments are where a shallow buffer costs the most speed.
+
+Usage: uni_lookahead.py [--config Marlin] [--blocks 16,32,64] file.gcode
+"""
+
+import argparse, math
+from pathlib import Path
+from uni_step_rate import moves, config_array, config_value
+
+def segment_time(length, v0, v1, vmax, accel):
+    """Time to cover a trapezoid block of 'length' mm from v0 to v1 capped at vmax."""
+    d_acc = (vmax * vmax - v0 * v0) / (2 * accel)
+    d_dec = (vmax * vmax - v1 * v1) / (2 * accel)
+    if d_acc + d_dec > length:
+        # Triangle profile: peak speed where the two ramps meet
+        vmax = math.sqrt((2 * accel * length + v0 * v0 + v1 * v1) / 2)
+        return (vmax - v0) / accel + (vmax - v1) / accel
+    return (vmax - v0) / accel + (vmax - v1) / accel + (length - d_acc - d_dec) / vmax
+
+def simulate(blocks, depth, accel):
+    """Average feedrate (mm/s) over 'blocks' = [(length, nominal_speed, junction_limit)]."""
+    n = len(blocks)
+    entry = [0.0] * (n + 1)
+    for i in range(n):
+        # Fastest entry that still lets the planner stop at the end of the queued window
+        v = 0.0
+        for k in range(min(n, i + depth) - 1, i - 1, -1):
+            v = min(blocks[k][2], math.sqrt(v * v + 2 * accel * blocks[k][0]))
+        reachable = math.sqrt(entry[i - 1] ** 2 + 2 * accel * blocks[i - 1][0]) if i else 0.0
+        entry[i] = min(v, reachable, blocks[i][1])
+    for i in range(n):
+        entry[i + 1] = min(entry[i + 1], math.sqrt(entry[i] ** 2 + 2 * accel * blocks[i][0]))
+    total = sum(b[0] for b in blocks)
+    time = sum(segment_time(b[0], entry[i], entry[i + 1], b[1], accel) for i, b in enumerate(blocks))
+    return total / time if time else 0.0
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('gcode')
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h')
+    ap.add_argument('--blocks', default='16,32,64', help='comma-separated BLOCK_BUFFER_SIZE values')
+    args = ap.parse_args()
+
+    text = Path(args.config, 'Configuration.h').read_text(errors='ignore')
+    adv = Path(args.config, 'Configuration_adv.h').read_text(errors='ignore')
+    max_feed = config_array(text, 'DEFAULT_MAX_FEEDRATE')[:3]
+    accel = float(config_value(text, 'DEFAULT_ACCELERATION').split()[0])
+    jd = float(config_value(text, 'JUNCTION_DEVIATION_MM').split()[0])
+    max_arc_segment = float(config_value(adv, 'MAX_ARC_SEGMENT_MM') or 1.0)
+
+    blocks, prev_unit, prev_nominal = [], None, 0.0
+    for delta, feed in moves(args.gcode, max_arc_segment):
+        length = math.sqrt(sum(d * d for d in delta[:3]))
+        if length == 0: continue
+        unit = [ d / length for d in delta[:3] ]
+        nominal = min([feed] + [ max_feed[i] / abs(unit[i]) for i in range(3) if unit[i] ])
+        junction = 0.0
+        if prev_unit:
+            cos_theta = -sum(a * b for a, b in zip(prev_unit, unit))
+            if cos_theta < -0.999999: junction = nominal
+            elif cos_theta < 0.999999:
+                sin_theta_d2 = math.sqrt(0.5 * (1.0 - cos_theta))
+                junction = math.sqrt(accel * jd * sin_theta_d2 / (1.0 - sin_theta_d2))
+        blocks.append((length, nominal, min(junction, nominal, prev_nominal)))
+        prev_unit, prev_nominal = unit, nominal
+
+    print('%d blocks, %.1f mm' % (len(blocks), sum(b[0] for b in blocks)))
+    for depth in (int(x) for x in args.blocks.split(',')):
+        print('BLOCK_BUFFER_SIZE %3d : %8.1f mm/s' % (depth, simulate(blocks, depth, accel)))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""
+uni_sd_bench.py
+
+SD printing benchmark for the STM32F401CCU6 UNI.
+
+Streams a G-code file out of a FAT16/FAT32 SD card image through a model of
+the UNI SD path (SPI1 on EXP2: SDSS PA4, SCK PA5, MISO PA6, MOSI PA7) and
+into Marlin's command queue and planner. Two read paths are compared:
+
+  single  what Marlin does today: one CMD17 per 512-byte sector, polled SPI
+          with the CPU busy for the whole transfer, plus a FAT lookup when a
+          cluster ends.
+  stream  CMD18 multi-block reads over each contiguous cluster run, DMA into
+          --buffers sector buffers ahead of the parser. The CPU only takes
+          one interrupt per sector.
+
+The main loop fills BUFSIZE command slots from the card, then plans one
+command, waiting while the BLOCK_BUFFER_SIZE planner is full. Moves take
+their length over their feedrate with no acceleration, which is the worst
+case for starving the planner. For each path the report gives card
+throughput, the CPU share spent reading, parser waits for data, and the
+planner starvation events that make the machine stutter.
+
+Usage: uni_sd_bench.py [--config Marlin] sd.img /PATH/FILE.GCO
+"""
+
+import argparse, math, re, struct
+from collections import deque
+from pathlib import Path
+from uni_step_rate import Modal, config_value, line_moves
+
+SECTOR = 512
+
+class FatImage:
+    """FAT16/FAT32 image held in a bytearray (uni_sd_eeprom.Volume writes to it), optionally behind an MBR. 8.3 names only."""
+    def __init__(self, path):
+        self.data = bytearray(Path(path).read_bytes())
+        self.base = 0
+        boot = self.sector(0)
+        if boot[0] not in (0xEB, 0xE9) and boot[510:512] == b'\x55\xaa':
+            self.base, = struct.unpack_from('<I', boot, 0x1C6)
+            boot = self.sector(0)
+        bps, spc, reserved, nfats, root_entries, total16, _, fatsz16 = struct.unpack_from('<HBHBHHBH', boot, 11)
+        total32, fatsz32, _, _, self.root_cluster = struct.unpack_from('<IIHHI', boot, 32)
+        if bps != SECTOR: raise SystemExit('Only 512-byte sectors are supported')
+        self.spc, self.nfats, self.fatsz = spc, nfats, fatsz16 or fatsz32
+        self.fat_start = reserved
+        self.root_start = reserved + nfats * self.fatsz
+        self.data_start = self.root_start + (root_entries * 32 + SECTOR - 1) // SECTOR
+        self.fat32 = ((total16 or total32) - self.data_start) // spc >= 65525
+        if not self.fat32: self.root_cluster = None
+
+    def sector(self, lba):
+        start = (self.base + lba) * SECTOR
+        return self.data[start:start + SECTOR]
+
+    def next_cluster(self, c):
+        """Return (next cluster or None, FAT sector holding the entry)."""
+        width = 4 if self.fat32 else 2
+        offset = c * width
+        lba = self.fat_start + offset // SECTOR
+        value, = struct.unpack_from('<I' if self.fat32 else '<H', self.sector(lba), offset % SECTOR)
+        if self.fat32: value &= 0x0FFFFFFF
+        return (None if value >= (0x0FFFFFF8 if self.fat32 else 0xFFF8) else value), lba
+
+    def chain(self, c):
+        while c:
+            yield c
+            c, _ = self.next_cluster(c)
+
+    def cluster_lba(self, c):
+        return self.data_start + (c - 2) * self.spc
+
+    def entries(self, cluster):
+        sectors = [ self.root_start + i for i in range(self.data_start - self.root_start) ] if cluster is None else \
+                  [ self.cluster_lba(c) + i for c in self.chain(cluster) for i in range(self.spc) ]
+        for lba in sectors:
+            block = self.sector(lba)
+            for off in range(0, SECTOR, 32):
+                e = block[off:off + 32]
+                if e[0] == 0: return
+                if e[0] == 0xE5 or e[11] == 0x0F: continue
+                name = e[0:8].decode('latin-1').rstrip() + ('.' + e[8:11].decode('latin-1').rstrip() if e[8:11].strip() else '')
+                hi, = struct.unpack_from('<H', e, 20)
+                lo, size = struct.unpack_from('<HI', e, 26)
+                yield name.upper(), (hi << 16) | lo, size, e[11] & 0x10
+
+    def open(self, path):
+        """Return (sectors, contents): one (lba, fat_lba or None) per sector, fat_lba set where a cluster ends."""
+        cluster = self.root_cluster
+        parts = [ p.upper() for p in path.strip('/').split('/') ]
+        for i, part in enumerate(parts):
+            found = next((e for e in self.entries(cluster) if e[0] == part), None)
+            if not found: raise SystemExit('%s: not found in image' % path)
+            _, cluster, size, is_dir = found
+            if bool(is_dir) != (i < len(parts) - 1): raise SystemExit('%s: not a file' % path)
+        sectors, content = [], bytearray()
+        c = cluster
+        while c and len(content) < size:
+            nxt, fat_lba = self.next_cluster(c)
+            for i in range(self.spc):
+                if len(content) >= size: break
+                lba = self.cluster_lba(c) + i
+                sectors.append((lba, fat_lba if i == self.spc - 1 else None))
+                content += self.sector(lba)
+            c = nxt
+        return sectors, bytes(content[:size])
+
+def block_buffer_size(text):
+    """BLOCK_BUFFER_SIZE from Configuration_adv.h, following its SDSUPPORT / DIRECT_STEPPING #if chain."""
+    on = lambda name: config_value(text, name) is not None
+    m = re.search(r'^\s*#if\s+BOTH\(SDSUPPORT,\s*DIRECT_STEPPING\)\s*#define\s+BLOCK_BUFFER_SIZE\s+(\d+)\s*'
+                  r'#elif\s+ENABLED\(SDSUPPORT\)\s*#define\s+BLOCK_BUFFER_SIZE\s+(\d+)\s*'
+                  r'#else\s*#define\s+BLOCK_BUFFER_SIZE\s+(\d+)', text, re.M)
+    if not m: return int(config_value(text, 'BLOCK_BUFFER_SIZE') or 16)
+    both, sd, plain = (int(v) for v in m.groups())
+    return (both if on('DIRECT_STEPPING') else sd) if on('SDSUPPORT') else plain
+
+def line_blocks(line, state, arc_mm):
+    """Planner block durations (s) for one G-code line. state is the uni_step_rate.Modal carried between lines."""
+    blocks = []
+    for delta, feed in line_moves(line, state, arc_mm):
+        dist = math.sqrt(sum(d * d for d in delta[:3])) or abs(delta[3])
+        if dist: blocks.append(dist / feed)
+    return blocks
+
+def simulate(sectors, lines, mode, args):
+    # Card timing
+    byte_s = 8.0 / (args.spi_mhz * 1e6)
+    poll_s = byte_s + args.poll_gap_us * 1e-6
+    xfer_poll = args.access_us * 1e-6 + (SECTOR + 10) * poll_s
+    xfer_dma = (SECTOR + 2) * byte_s + args.stream_gap_us * 1e-6
+
+    # Stream path: when each sector lands in a buffer. A buffer frees up once the parser has moved past it.
+    # The card stops streaming (CMD12) when all buffers are full, and a new CMD18 pays the access latency.
+    ready, consumed, card = [], [], [0.0]
+    def stream_ready(k):
+        while len(ready) <= k:
+            i = len(ready)
+            start = ready[i - 1] if i else 0.0
+            if i >= args.buffers: start = max(start, consumed[i - args.buffers])
+            busy = xfer_dma
+            if not i or sectors[i][0] != sectors[i - 1][0] + 1 or start > ready[i - 1]:
+                busy += args.access_us * 1e-6
+            card[0] += busy
+            ready.append(start + busy)
+        return ready[k]
+
+    t = read_cpu = wait = 0.0
+    waits = starvations = 0
+    starved = motion_end = 0.0
+    planner, queue = deque(), deque()
+    sector, line_i = -1, 0
+    while line_i < len(lines) or queue:
+        # Fill the command queue from the card
+        while line_i < len(lines) and len(queue) < args.bufsize:
+            end_sector, nbytes, blocks = lines[line_i]
+            while sector < end_sector:
+                sector += 1
+                if mode == 'single':
+                    cost = xfer_poll + (xfer_poll if sector and sectors[sector - 1][1] is not None else 0.0)
+                    t += cost
+                    read_cpu += cost
+                    card[0] += cost
+                else:
+                    if sector: consumed.append(t)
+                    r = stream_ready(sector)
+                    if r > t:
+                        waits += 1
+                        wait += r - t
+                        t = r
+                    t += args.dma_isr_us * 1e-6
+                    read_cpu += args.dma_isr_us * 1e-6
+            t += nbytes * args.get_ns * 1e-9
+            read_cpu += nbytes * args.get_ns * 1e-9
+            queue.append(blocks)
+            line_i += 1
+        # Plan one command
+        blocks = queue.popleft()
+        t += args.parse_us * 1e-6
+        for d in blocks:
+            while planner and planner[0] <= t: planner.popleft()
+            if len(planner) >= args.blocks:
+                t = planner.popleft()
+            if planner or motion_end:
+                if t > motion_end and not planner:
+                    starvations += 1
+                    starved += t - motion_end
+            motion_end = max(t, motion_end) + d
+            planner.append(motion_end)
+    return { 'time': max(t, motion_end), 'card': card[0], 'read_cpu': read_cpu, 'waits': waits, 'wait': wait,
+             'starvations': starvations, 'starved': starved }
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('image', help='SD card image (raw FAT16/FAT32, with or without MBR)')
+    ap.add_argument('file', help='8.3 path of the G-code file in the image')
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h')
+    ap.add_argument('--spi-mhz', type=float, default=10.5, help='SPI1 clock: SPI_FULL_SPEED is 84 MHz / 8')
+    ap.add_argument('--poll-gap-us', type=float, default=0.3, help='CPU time between polled SPI bytes')
+    ap.add_argument('--access-us', type=float, default=300, help='card read latency per read command')
+    ap.add_argument('--stream-gap-us', type=float, default=20, help='gap between blocks of a CMD18 read')
+    ap.add_argument('--dma-isr-us', type=float, default=3, help='CPU time per DMA completion')
+    ap.add_argument('--buffers', type=int, default=2, help='read-ahead sector buffers for the stream path')
+    ap.add_argument('--get-ns', type=float, default=150, help='CPU time per byte in CardReader::get()')
+    ap.add_argument('--parse-us', type=float, default=60, help='CPU time to parse and plan one command')
+    ap.add_argument('--blocks', type=int, help='BLOCK_BUFFER_SIZE, default from Configuration_adv.h')
+    args = ap.parse_args()
+
+    text = ''.join(Path(args.config, f).read_text(errors='ignore') for f in ('Configuration.h', 'Configuration_adv.h'))
+    args.bufsize = int(config_value(text, 'BUFSIZE') or 4)
+    if args.blocks is None: args.blocks = block_buffer_size(text)
+    if config_value(text, 'SDSUPPORT') is None: print('Note: SDSUPPORT is disabled in %s' % args.config)
+    arc_mm = float(config_value(text, 'MAX_ARC_SEGMENT_MM') or config_value(text, 'MM_PER_ARC_SEGMENT') or 1.0)
+
+    sectors, content = FatImage(args.image).open(args.file)
+    state, lines, pos = Modal(), [], 0
+    for raw in content.split(b'\n'):
+        pos += len(raw) + 1
+        lines.append(((min(pos, len(content)) - 1) // SECTOR, len(raw) + 1, line_blocks(raw.decode('latin-1'), state, arc_mm)))
+    motion = sum(sum(b) for _, _, b in lines)
+
+    print('%s: %d bytes in %d sectors, %d lines, %.1f s of motion. BUFSIZE %d, BLOCK_BUFFER_SIZE %d' % (
+        args.file, len(content), len(sectors), len(lines), motion, args.bufsize, args.blocks))
+    print('%-7s %10s %10s %12s %14s %18s %10s' % ('Path', 'Card kB/s', 'Read CPU', 'Parser waits', 'Starvations', 'Starved time', 'Job time'))
+    for mode in ('single', 'stream'):
+        r = simulate(sectors, lines, mode, args)
+        print('%-7s %10.0f %9.1f%% %12d %14d %16.3f s %8.1f s' % (mode, len(content) / r['card'] / 1000, 100 * r['read_cpu'] / r['time'],
+            r['waits'], r['starvations'], r['starved'], r['time']))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""
+uni_sd_eeprom.py
+
+SD card EEPROM emulation model for the STM32F401CCU6 UNI.
+
+Replays a series of M500 saves against a copy of an SD card image
+(FAT16/FAT32) with three ways of storing the MARLIN_EEPROM_SIZE settings
+image, and cuts the power after every single sector write to see what the
+next boot would load:
+
+  rewrite   what SDCARD_EEPROM_EMULATION does today: truncate EEPROM.DAT and
+            write the whole image again, FAT and directory entry included.
+  inplace   keep the image cached in RAM, track dirty 512-byte pages and
+            write back only those, in place.
+  atomic    as inplace, but into the older of two preallocated copies
+            (EEPROM.DAT, EEPROM.ALT). A header sector with a sequence
+            number and CRC32 is written last to commit, and boot loads the
+            newest copy whose CRC matches.
+
+A boot that finds neither the old nor the new settings falls back to the
+defaults (Marlin's settings CRC fails), or worse, loads a mix that passes it.
+The report gives sectors and bytes written per save, save time, and the
+share of power-loss points that leave the settings intact.
+
+The input image is not modified. EEPROM.DAT and EEPROM.ALT are created in
+the root directory of the in-memory copy when missing.
+
+Usage: uni_sd_eeprom.py [--config Marlin] [--saves 100] [--changes 2] sd.img
+"""
+
+import argparse, binascii, random, re, struct, zlib
+from pathlib import Path
+from uni_sd_bench import FatImage, SECTOR
+
+EEPROM_OFFSET = 100     # Marlin's settings start: 4-byte version, 2-byte CRC, then the data
+MAGIC = b'UNIE'
+
+def pack83(name):
+    base, _, ext = name.upper().partition('.')
+    return base.ljust(8).encode() + ext.ljust(3).encode()
+
+class Volume(FatImage):
+    """FatImage with just enough write support to preallocate files in the root directory."""
+    def write(self, lba, block):
+        start = (self.base + lba) * SECTOR
+        self.data[start:start + SECTOR] = block
+
+    def root_sectors(self):
+        if self.root_cluster is None: return range(self.root_start, self.data_start)
+        return [ self.cluster_lba(c) + i for c in self.chain(self.root_cluster) for i in range(self.spc) ]
+
+    def entry(self, name):
+        """(lba, offset, exists) of the root directory entry for an 8.3 name, or of the first free slot (None if full)."""
+        raw, free = pack83(name), None
+        for lba in self.root_sectors():
+            block = self.sector(lba)
+            for off in range(0, SECTOR, 32):
+                if block[off:off + 11] == raw: return lba, off, True
+                if free is None and block[off] in (0, 0xE5): free = (lba, off, False)
+        return free
+
+    def fat_sectors(self, c):
+        width = 4 if self.fat32 else 2
+        return [ self.fat_start + f * self.fatsz + c * width // SECTOR for f in range(self.nfats) ]
+
+    def set_fat(self, c, value):
+        width = 4 if self.fat32 else 2
+        for lba in self.fat_sectors(c):
+            block = self.sector(lba)
+            struct.pack_into('<I' if self.fat32 else '<H', block, c * width % SECTOR, value)
+            self.write(lba, block)
+
+    def create(self, name, size):
+        slot = self.entry(name)
+        if not slot: raise SystemExit('%s: root directory full, no free entry to create it' % name)
+        lba, off, exists = slot
+        if exists: return
+        count, free, c = -(-size // (self.spc * SECTOR)), [], 2
+        while len(free) < count:
+            if self.next_cluster(c)[0] == 0: free.append(c)
+            c += 1
+        for i, c in enumerate(free):
+            self.set_fat(c, free[i + 1] if i + 1 < count else (0x0FFFFFFF if self.fat32 else 0xFFFF))
+            for s in range(self.spc): self.write(self.cluster_lba(c) + s, bytes(SECTOR))
+        block = self.sector(lba)
+        block[off:off + 32] = pack83(name) + b'\x20' + bytes(20)
+        struct.pack_into('<H', block, off + 20, free[0] >> 16)
+        struct.pack_into('<HI', block, off + 26, free[0] & 0xFFFF, size)
+        self.write(lba, block)
+
+def pages(image):
+    return [ image[i:i + SECTOR] for i in range(0, len(image), SECTOR) ]
+
+class Rewrite:
+    """Truncate and rewrite the whole file, as the current emulation does on every M500."""
+    names = ('EEPROM.DAT',)
+
+    def __init__(self, vol, size):
+        self.vol, self.size = vol, size
+        sectors, _ = vol.open('/EEPROM.DAT')
+        self.sectors = [ lba for lba, _ in sectors ]
+        self.entry = vol.entry('EEPROM.DAT')[:2]
+        clusters = sorted({ (lba - vol.data_start) // vol.spc + 2 for lba in self.sectors })
+        self.fat = sorted({ lba for c in clusters for lba in vol.fat_sectors(c) })
+
+    def init(self, image):
+        for lba, block in zip(self.sectors, pages(image)): self.vol.write(lba, block)
+
+    def set_size(self, size):
+        lba, off = self.entry
+        block = self.vol.sector(lba)
+        struct.pack_into('<I', block, off + 28, size)
+        return lba, block
+
+    def save(self, old, new):
+        yield self.set_size(0)                                          # O_TRUNC frees the chain
+        for lba in self.fat: yield lba, self.vol.sector(lba)
+        for lba, block in zip(self.sectors, pages(new)): yield lba, block
+        for lba in self.fat: yield lba, self.vol.sector(lba)            # and allocates it again
+        yield self.set_size(self.size)                                  # close() updates the entry
+
+    def load(self):
+        lba, off = self.entry
+        size, = struct.unpack_from('<I', self.vol.sector(lba), off + 28)
+        if size != self.size: return None
+        return b''.join(self.vol.sector(lba) for lba in self.sectors)
+
+class InPlace(Rewrite):
+    """Write back only the dirty pages of the RAM copy, in place."""
+    def save(self, old, new):
+        for lba, a, b in zip(self.sectors, pages(old), pages(new)):
+            if a != b: yield lba, b
+
+class Atomic:
+    """Dirty pages go to the older of two copies, then its header commits them."""
+    names = ('EEPROM.DAT', 'EEPROM.ALT')
+
+    def __init__(self, vol, size):
+        self.vol, self.size = vol, size
+        self.copies = [ [ lba for lba, _ in vol.open('/' + n)[0] ] for n in self.names ]
+        self.held, self.current, self.seq = [ None, None ], 0, 0
+
+    def header(self, seq, image):
+        return MAGIC + struct.pack('<III', seq, len(image), zlib.crc32(image)) + bytes(SECTOR - 16)
+
+    def write_copy(self, k, image):
+        target = self.copies[k]
+        held = pages(self.held[k]) if self.held[k] else [ None ] * len(target)
+        for lba, a, b in zip(target[1:], held, pages(image)):
+            if a != b: yield lba, b
+        self.seq += 1
+        yield target[0], self.header(self.seq, image)
+        self.held[k], self.current = image, k
+
+    def init(self, image):
+        for k in (1, 0):
+            for lba, block in self.write_copy(k, image): self.vol.write(lba, block)
+
+    def save(self, old, new):
+        return self.write_copy(1 - self.current, new)
+
+    def load(self):
+        best = None
+        for copy in self.copies:
+            magic, seq, size, crc = struct.unpack_from('<4sIII', self.vol.sector(copy[0]))
+            if magic != MAGIC or size != self.size: continue
+            image = b''.join(self.vol.sector(lba) for lba in copy[1:])
+            if zlib.crc32(image) == crc and (best is None or seq > best[0]): best = (seq, image)
+        return best and best[1]
+
+def settings_valid(image, settings):
+    crc, = struct.unpack_from('<H', image, EEPROM_OFFSET + 4)
+    return crc == binascii.crc_hqx(image[EEPROM_OFFSET + 6:EEPROM_OFFSET + settings], 0)
+
+def workload(rng, size, settings, changes, saves):
+    """Settings images for M500 after M500, each changing a few 4-byte fields."""
+    image = bytearray(b'\xff' * size)
+    image[EEPROM_OFFSET:EEPROM_OFFSET + 4] = b'V87\0'
+    image[EEPROM_OFFSET + 6:EEPROM_OFFSET + settings] = bytes(rng.randrange(256) for _ in range(settings - 6))
+    images = []
+    for _ in range(saves + 1):
+        for _ in range(changes):
+            at = rng.randrange(EEPROM_OFFSET + 6, EEPROM_OFFSET + settings - 4)
+            image[at:at + 4] = bytes(rng.randrange(256) for _ in range(4))
+        struct.pack_into('<H', image, EEPROM_OFFSET + 4, binascii.crc_hqx(image[EEPROM_OFFSET + 6:EEPROM_OFFSET + settings], 0))
+        images.append(bytes(image))
+    return images
+
+def run(strategy, args, images):
+    vol = Volume(args.image)
+    for name in strategy.names: vol.create(name, args.size + (SECTOR if strategy is Atomic else 0))
+    store = strategy(vol, args.size)
+    store.init(images[0])
+    writes = worst = points = intact = lost = wrong = 0
+    for old, new in zip(images, images[1:]):
+        n = 0
+        for lba, block in store.save(old, new):
+            vol.write(lba, block)
+            n += 1
+            image = store.load()
+            if image == new: continue                       # Committed (or the last write)
+            points += 1
+            if image == old: intact += 1
+            elif image is None or not settings_valid(image, args.settings): lost += 1
+            else: wrong += 1
+        if store.load() != new: raise SystemExit('%s: save did not commit' % strategy.__name__)
+        writes += n
+        worst = max(worst, n)
+    saves = len(images) - 1
+    print('%-8s %8.1f %10.1f %9.1f %9.1f %10d %9.1f%% %8d %8d' % (strategy.__name__.lower(), writes / saves,
+        writes * SECTOR / 1024, writes / saves * args.write_ms, worst * args.write_ms,
+        points, 100.0 * intact / points if points else 100.0, lost, wrong))
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('image', help='SD card image (raw FAT16/FAT32, with or without MBR)')
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h and src/pins')
+    ap.add_argument('--size', type=lambda v: int(v, 0), help='MARLIN_EEPROM_SIZE, default from the UNI pins file')
+    ap.add_argument('--settings', type=int, default=700, help='bytes of SettingsData actually stored')
+    ap.add_argument('--changes', type=int, default=2, help='4-byte fields changed per M500')
+    ap.add_argument('--saves', type=int, default=100)
+    ap.add_argument('--write-ms', type=float, default=1.5, help='CMD24 single block write, including busy')
+    ap.add_argument('--seed', type=int, default=1)
+    args = ap.parse_args()
+
+    if args.size is None:
+        pins = Path(args.config, 'src/pins/stm32f4/pins_STM32F401CCU6_UNI.h').read_text()
+        args.size = int(re.search(r'ENABLED\(SDCARD_EEPROM_EMULATION\)\s*\n\s*#define MARLIN_EEPROM_SIZE\s+(\w+)', pins).group(1), 0)
+    images = workload(random.Random(args.seed), args.size, args.settings, args.changes, args.saves)
+
+    print('MARLIN_EEPROM_SIZE 0x%X, %d M500 saves changing %d fields, %.1f ms per sector write' % (
+        args.size, args.saves, args.changes, args.write_ms))
+    print('%-8s %8s %10s %9s %9s %10s %10s %8s %8s' % ('Store', 'Sectors', 'Total kB', 'Avg ms', 'Max ms',
+        'Cut points', 'Intact', 'Lost', 'Wrong'))
+    for strategy in (Rewrite, InPlace, Atomic):
+        run(strategy, args, images)
+
+if __name__ == '__main__':
+    main()
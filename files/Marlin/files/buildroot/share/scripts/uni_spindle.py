@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+uni_spindle.py
+
+Spindle model for the STM32F401CCU6 UNI RPM output.
+
+With SPINDLE_FEATURE, PB3 drives the RPM connector: its PWM is filtered into
+0-10V (R605 sets the voltage at 100% duty) and the spindle driver turns that
+into a speed, ramping at its own acceleration.
+
+--calibrate fits the driver: give the S values sent with M3 and the RPM
+measured for each, and the tool works out the duty cycle Marlin output for
+them with the current SPEED_POWER_MIN/MAX and CUTTER_POWER_RELATIVE, fits
+RPM against duty and prints the values that make S match the real speed.
+
+With a job file, every M3/M4/M5 is replayed against the driver ramp and the
+moves around it, in two ways:
+
+  dwell   what Marlin does: finish the queued moves, set the new speed, then
+          wait SPINDLE_LASER_POWERUP_DELAY (M3/M4) or POWERDOWN_DELAY (M5).
+          Feed moves (G1/G2/G3) that start while the spindle is still more
+          than --tolerance away from the commanded speed cut under speed.
+  ramp    the speed is set at its block boundary without waiting, the
+          spindle ramps during the rapids (G0) that follow, and a dwell is
+          added only before a feed move if the ramp has not finished.
+
+The report lists each speed change and gives job time, time spent dwelling
+and feed distance cut under speed, and the shortest delays that would avoid
+cutting under speed with the dwell method: for this job, and for any job with
+S between SPEED_POWER_MIN and SPEED_POWER_MAX. Lines with axis words and no
+G word repeat the last G0-G3 (GCODE_MOTION_MODES).
+
+Usage: uni_spindle.py [--accel 8000] [--decel 6000] job.gcode
+       uni_spindle.py --calibrate 5000:4650,15000:14900,25000:25300
+"""
+
+import argparse, math, re
+from pathlib import Path
+from uni_step_rate import Modal, config_value
+from uni_sd_bench import line_blocks
+
+class Spindle:
+    """Driver speed: slews toward the target at accel (up) or decel (down) RPM/s."""
+    def __init__(self, accel, decel):
+        self.accel, self.decel = accel, decel
+        self.rpm = self.target = 0.0
+
+    def set(self, target):
+        self.target = target
+
+    def settle_time(self, tolerance):
+        """Seconds until the speed is within tolerance of the target."""
+        band = tolerance * self.target
+        gap = abs(self.target - self.rpm) - band
+        return max(0.0, gap) / (self.accel if self.target > self.rpm else self.decel)
+
+    def run(self, dt):
+        rate = self.accel if self.target > self.rpm else self.decel
+        step = rate * dt
+        self.rpm = self.target if abs(self.target - self.rpm) <= step else self.rpm + math.copysign(step, self.target - self.rpm)
+
+def job(path, arc_mm, startup):
+    """Yield ('spindle', rpm, line number) and ('move', [durations], feed_mm_s, cutting) from a G-code file."""
+    state = Modal()
+    for n, raw in enumerate(Path(path).read_text(errors='ignore').splitlines(), 1):
+        line = raw.split(';', 1)[0].strip().upper()
+        words = dict((w[0], float(w[1:])) for w in re.findall(r'[A-Z][-+]?[0-9.]+', line))
+        m = words.get('M')
+        if m in (3, 4): yield 'spindle', words.get('S', startup), n
+        elif m == 5: yield 'spindle', 0.0, n
+        blocks = line_blocks(line, state, arc_mm)
+        if blocks: yield 'move', blocks, state.feed, state.motion in (1, 2, 3)
+
+def simulate(events, method, args):
+    sp = Spindle(args.accel, args.decel)
+    t = dwell = under_mm = under_s = 0.0
+    changes = []
+    for ev in events:
+        if ev[0] == 'spindle':
+            sp.set(ev[1])
+            change = [ev[2], sp.rpm, ev[1], sp.settle_time(args.tolerance), 0.0, 0.0]
+            changes.append(change)
+            if method == 'dwell':
+                d = args.powerup if ev[1] else args.powerdown
+                sp.run(d)
+                t += d
+                dwell += d
+                change[4] = d
+            continue
+        _, blocks, feed, cutting = ev
+        if cutting and method == 'ramp':
+            d = sp.settle_time(args.tolerance)
+            if d:
+                sp.run(d)
+                t += d
+                dwell += d
+                if changes: changes[-1][4] += d
+        for dur in blocks:
+            # Split each block into short slices to integrate the distance cut under speed
+            steps = max(1, int(dur / 0.005))
+            for _ in range(steps):
+                if cutting and sp.target and abs(sp.rpm - sp.target) > args.tolerance * sp.target:
+                    under_s += dur / steps
+                    under_mm += feed * dur / steps
+                    if changes: changes[-1][5] += feed * dur / steps
+                sp.run(dur / steps)
+            t += dur
+    return t, dwell, under_mm, under_s, changes
+
+def duty(s, smin, smax, relative):
+    """Marlin's cpwr_to_pct(): the PWM duty (%) output for M3 S<s>."""
+    if not s: return 0.0
+    floor = smin if relative else 0
+    return min(100.0, max(0.0, 100.0 * (s - floor) / (smax - floor)))
+
+def calibrate(points, smin, smax, relative, vmax):
+    xs = [ duty(s, smin, smax, relative) for s, _ in points ]
+    ys = [ rpm for _, rpm in points ]
+    n, mx, my = len(xs), sum(xs) / len(xs), sum(ys) / len(ys)
+    sxx = sum((x - mx) ** 2 for x in xs)
+    if n < 2 or not sxx: raise SystemExit('--calibrate needs at least two different speeds')
+    slope = sum((x - mx) * (y - my) for x, y in zip(xs, ys)) / sxx
+    at0 = my - slope * mx
+    print('%8s %7s %7s %9s %9s' % ('S', 'Duty', 'Volts', 'Measured', 'Fit'))
+    for (s, rpm), x in zip(points, xs):
+        print('%8.0f %6.1f%% %6.2fV %9.0f %9.0f' % (s, x, x * vmax / 100, rpm, at0 + slope * x))
+    print('RPM = %.0f + %.1f x duty%%: %.0f RPM at 0V, %.0f RPM at %.1fV' % (at0, slope, at0, at0 + 100 * slope, vmax))
+    if at0 > 0.02 * (at0 + 100 * slope):
+        print('#define CUTTER_POWER_RELATIVE')
+        print('#define SPEED_POWER_MIN %8d    // (RPM) at 0V' % round(at0))
+    else:
+        if at0 < 0: print('Note: the driver ignores the first %.2fV; S below %.0f stops the spindle' % (-at0 / slope * vmax / 100, -at0))
+        print('//#define CUTTER_POWER_RELATIVE')
+    print('#define SPEED_POWER_MAX %8d    // (RPM) at %.1fV' % (round(at0 + 100 * slope), vmax))
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('gcode', nargs='?')
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h')
+    ap.add_argument('--calibrate', help='comma-separated S:measured RPM pairs')
+    ap.add_argument('--vmax', type=float, default=10.0, help='RPM output at 100%% duty, as set with R605 (V)')
+    ap.add_argument('--accel', type=float, default=8000, help='driver ramp up (RPM/s)')
+    ap.add_argument('--decel', type=float, default=6000, help='driver ramp down (RPM/s)')
+    ap.add_argument('--tolerance', type=float, default=0.05, help='speed error allowed while cutting (fraction)')
+    ap.add_argument('--powerup', type=float, help='SPINDLE_LASER_POWERUP_DELAY to try (ms), default from the config')
+    ap.add_argument('--powerdown', type=float, help='SPINDLE_LASER_POWERDOWN_DELAY to try (ms)')
+    ap.add_argument('--show', type=int, default=20, help='speed changes to list')
+    args = ap.parse_args()
+
+    text = ''.join(Path(args.config, f).read_text(errors='ignore') for f in ('Configuration.h', 'Configuration_adv.h'))
+    smin = float(config_value(text, 'SPEED_POWER_MIN') or 0)
+    smax = float(config_value(text, 'SPEED_POWER_MAX') or 30000)
+    relative = config_value(text, 'CUTTER_POWER_RELATIVE') is not None
+
+    if args.calibrate:
+        points = [ tuple(float(v) for v in p.split(':')) for p in args.calibrate.split(',') ]
+        calibrate(points, smin, smax, relative, args.vmax)
+        return
+    if not args.gcode: ap.error('a job file or --calibrate is required')
+
+    args.powerup = (args.powerup if args.powerup is not None else float(config_value(text, 'SPINDLE_LASER_POWERUP_DELAY') or 0)) / 1000
+    args.powerdown = (args.powerdown if args.powerdown is not None else float(config_value(text, 'SPINDLE_LASER_POWERDOWN_DELAY') or 0)) / 1000
+    arc_mm = float(config_value(text, 'MAX_ARC_SEGMENT_MM') or config_value(text, 'MM_PER_ARC_SEGMENT') or 1.0)
+    startup = float(config_value(text, 'SPEED_POWER_STARTUP') or smax)
+    events = list(job(args.gcode, arc_mm, startup))
+
+    print('Driver ramp +%.0f/-%.0f RPM/s, tolerance %.0f%%, SPINDLE_LASER_POWERUP_DELAY %.0f ms, POWERDOWN_DELAY %.0f ms' % (
+        args.accel, args.decel, 100 * args.tolerance, 1000 * args.powerup, 1000 * args.powerdown))
+    results = { m: simulate(events, m, args) for m in ('dwell', 'ramp') }
+    changes = results['dwell'][4]
+    print('%6s %8s %8s %9s %11s %11s %11s' % ('Line', 'From', 'To', 'Ramp', 'Dwell wait', 'Under mm', 'Ramp wait'))
+    for c, r in list(zip(changes, results['ramp'][4]))[:args.show]:
+        print('%6d %8.0f %8.0f %8.2fs %10.2fs %11.1f %10.2fs' % (c[0], c[1], c[2], c[3], c[4], c[5], r[4]))
+    if len(changes) > args.show: print('  ... %d more' % (len(changes) - args.show))
+
+    print('%-6s %10s %10s %14s %14s' % ('Method', 'Job time', 'Dwelling', 'Under speed', 'Under time'))
+    for m, (t, dwell, mm, us, _) in results.items():
+        print('%-6s %9.1fs %9.1fs %11.1f mm %13.2fs' % (m, t, dwell, mm, us))
+    up = max([ c[3] for c in changes if c[2] ] or [0])         # M3/M4, speeding up or down
+    down = max([ c[3] for c in changes if not c[2] ] or [0])    # M5
+    print('Dwell method without cutting under speed, this job: SPINDLE_LASER_POWERUP_DELAY %d, SPINDLE_LASER_POWERDOWN_DELAY %d' % (
+        math.ceil(up * 10) * 100, math.ceil(down * 10) * 100))
+    # Any job: M3 from a stop to SPEED_POWER_MAX or from SPEED_POWER_MAX down to SPEED_POWER_MIN, M5 from SPEED_POWER_MAX
+    up = max(smax * (1 - args.tolerance) / args.accel, max(0.0, smax - smin * (1 + args.tolerance)) / args.decel)
+    print('Dwell method without cutting under speed, any S from %.0f to %.0f: SPINDLE_LASER_POWERUP_DELAY %d, SPINDLE_LASER_POWERDOWN_DELAY %d' % (
+        smin, smax, math.ceil(up * 10) * 100, math.ceil(smax / args.decel * 10) * 100))
+
+if __name__ == '__main__':
+    main()
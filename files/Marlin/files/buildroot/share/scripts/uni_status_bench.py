@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""
+uni_status_bench.py
+
+Status polling benchmark for the STM32F401CCU6 UNI.
+
+Streams a G-code file to the board (one line in flight, like uni_stream.py)
+while sending M114 at each of the --rates, the way a CNC host polls for
+position. M114 waits for a command slot like any other line and is answered
+from the main loop, at the priority of everything else the queue runs, so
+the stepper and USB interrupts never wait on a report. (S000 from
+REALTIME_REPORTING_COMMANDS is formatted inside the USB receive interrupt
+instead, which is why it stays off on the UNI.)
+
+For each rate the report gives the status round-trip time, the frame size
+and the bandwidth it takes, and what it costs the job: lines per second,
+planner starvation events (from ADVANCED_OK) and the extra job time per
+report compared with the first rate, which should be 0 (no polling). On a
+serial-bound dry run (many tiny G1 moves) the extra time is the main loop
+cost of a report. On a motion-bound job it should stay near zero, and new
+starvation events mean polling disturbs motion.
+
+--loop measures the main loop time of one M114 directly. The command queue
+is kept full of bare G4 with ADVANCED_OK credits, M114 taking the next free
+credit when it is due: nothing is planned, so the main loop is the
+bottleneck. Each rate runs for --seconds; the drop in G4 per second against
+no polling is the share of the main loop the reports take at that rate, and
+that share over the reports answered is the time per M114.
+
+Requires pyserial.
+
+Usage: uni_status_bench.py --port /dev/ttyACM0 [--rates 0,10,25,50] file.gcode
+       uni_status_bench.py --port /dev/ttyACM0 --loop [--seconds 30]
+"""
+
+import argparse, time
+from collections import deque
+import serial
+from uni_stream import Stats, gcode_lines
+
+PROBE = b'G4\n'
+
+STATUS = b'M114\n'
+
+class Lines:
+    """Line reader that never blocks longer than asked, so polls go out on time."""
+    def __init__(self, port):
+        self.port, self.buf = port, bytearray()
+
+    def read(self, timeout):
+        end = time.perf_counter() + timeout
+        while b'\n' not in self.buf:
+            left = end - time.perf_counter()
+            if left <= 0: return None
+            self.port.timeout = left
+            self.buf += self.port.read(max(1, self.port.in_waiting))
+        line, _, self.buf[:] = self.buf.partition(b'\n')
+        return line.decode(errors='ignore').strip()
+
+def run(port, reader, path, rate, stats):
+    """Stream the job, polling M114 at 'rate' Hz. Returns (elapsed, status RTTs, frame sizes)."""
+    lines = gcode_lines(path)
+    period = 1.0 / rate if rate else None
+    polls, rtt, frames = deque(), [], []
+    acks = deque()              # What each outstanding "ok" answers: the send time of a job line, or None for M114
+    start = time.perf_counter()
+    next_poll = start + (period or 0)
+    line, waiting = next(lines, None), False
+    while line is not None or acks:
+        if line is not None and not waiting:
+            port.write((line + '\n').encode())
+            acks.append(time.perf_counter())
+            waiting = True
+        polling = period and line is not None
+        now = time.perf_counter()
+        if polling and now >= next_poll:
+            port.write(STATUS)
+            polls.append(now)
+            acks.append(None)
+            next_poll += period
+        reply = reader.read(max(0.0, next_poll - time.perf_counter()) if polling else 10.0)
+        if reply is None:
+            if not polling: raise TimeoutError('no reply from board')
+            continue
+        if reply.startswith('X:') and polls:
+            rtt.append(time.perf_counter() - polls.popleft())
+            frames.append(len(reply) + 1)
+        elif reply.startswith('ok') and acks:
+            stats.advanced_ok(reply)
+            sent = acks.popleft()
+            if sent is None: continue
+            stats.rtt.append(time.perf_counter() - sent)
+            stats.lines += 1
+            line, waiting = next(lines, None), False
+        elif 'busy:' in reply:
+            stats.busy += 1
+    return time.perf_counter() - start, rtt, frames
+
+def run_loop(port, reader, seconds, rate, capacity, rx_bytes):
+    """Keep the queue full of bare G4 for 'seconds', with M114 at 'rate' Hz. Returns (G4 done, elapsed, reports)."""
+    period = 1.0 / rate if rate else None
+    in_flight, acked, reports = deque(), 0, 0      # Bytes of each unacknowledged command
+    start = time.perf_counter()
+    next_poll, end = start + (period or 0), start + seconds
+    while in_flight or time.perf_counter() < end:
+        while time.perf_counter() < end and len(in_flight) < capacity:
+            due = period and time.perf_counter() >= next_poll
+            data = STATUS if due else PROBE
+            if in_flight and sum(in_flight) + len(data) > rx_bytes: break
+            port.write(data)
+            in_flight.append(len(data))
+            if due: next_poll += period
+        reply = reader.read(10.0)
+        if reply is None: raise TimeoutError('no reply from board')
+        if reply.startswith('ok') and in_flight:
+            in_flight.popleft()
+            acked += 1
+        elif reply.startswith('X:'): reports += 1
+    return acked - reports, time.perf_counter() - start, reports
+
+def loop_cost(port, reader, args, capacity):
+    if not capacity: raise SystemExit('--loop needs ADVANCED_OK enabled in the firmware')
+    print('%6s %12s %12s %9s %14s %10s' % ('Rate', 'G4/s', 'us/G4', 'Reports', 'Loop us/M114', 'CPU share'))
+    base = None
+    for rate in (float(r) for r in args.rates.split(',')):
+        commands, elapsed, reports = run_loop(port, reader, args.seconds, rate, capacity, args.rx_bytes)
+        cps = commands / elapsed
+        if not rate: base = cps
+        share = 1.0 - cps / base if rate and base else None
+        print('%4.0fHz %12.0f %12.2f %9d %14s %10s' % (rate, cps, 1e6 / cps, reports,
+            '%.1f' % (1e6 * share * elapsed / reports) if share is not None and reports else '',
+            '%.2f%%' % (100 * share) if share is not None else ''))
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('gcode', nargs='?')
+    ap.add_argument('--port', required=True)
+    ap.add_argument('--baud', type=int, default=250000)
+    ap.add_argument('--rates', default='0,10,25,50', help='M114 polling rates to compare (Hz), 0 = none')
+    ap.add_argument('--loop', action='store_true', help='measure the main loop cost of M114 instead of a job')
+    ap.add_argument('--seconds', type=float, default=30, help='time per rate with --loop')
+    ap.add_argument('--rx-bytes', type=int, default=127, help='bytes allowed in flight with --loop')
+    args = ap.parse_args()
+    if not args.loop and not args.gcode: ap.error('a job file or --loop is required')
+    if args.loop and not args.rates.startswith('0,'): args.rates = '0,' + args.rates
+
+    with serial.Serial(args.port, args.baud, timeout=10) as port:
+        time.sleep(2)
+        port.reset_input_buffer()
+        port.write(b'M110 N0\n')
+        reader = Lines(port)
+        reply = ''
+        while not reply.startswith('ok'): reply = reader.read(10.0) or 'ok'
+        if args.loop:
+            loop_cost(port, reader, args, Stats().advanced_ok(reply))
+            return
+        base = None
+        print('%6s %9s %8s %10s %10s %10s %8s %8s %12s' % ('Rate', 'Lines/s', 'Starved', 'Status avg', 'Status p99',
+            'Answered', 'Frame', 'Bytes/s', 'Cost/report'))
+        for rate in (float(r) for r in args.rates.split(',')):
+            stats = Stats()
+            elapsed, rtt, frames = run(port, reader, args.gcode, rate, stats)
+            rtt.sort()
+            polls = len(rtt)
+            cost = '%9.2f ms' % (1000 * (elapsed - base) / polls) if base is not None and polls else ''
+            if not rate: base = elapsed
+            print('%4.0fHz %9.1f %8s %8.2f ms %8.2f ms %10d %8.0f %8.0f %12s' % (rate, stats.lines / elapsed,
+                stats.starved if stats.planner_size is not None else '?',
+                1000 * sum(rtt) / polls if polls else 0, 1000 * rtt[int(polls * 0.99)] if polls else 0, polls,
+                sum(frames) / polls if polls else 0, sum(frames) / elapsed, cost))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""
+uni_step_rate.py
+
+Step-rate benchmark for the STM32F401CCU6 UNI.
+
+Replays a G-code file against the axis settings in Marlin/Configuration.h
+and Configuration_adv.h and reports, for each microstepping mode, the peak
+step rate per axis and the peak combined rate the stepper ISR has to sustain.
+On the UNI every STEP pin sits on GPIOB (X PB9, Y PB5, Z PB15, E0 PB13), so
+the combined rate is the number of STEP edges per second on that port.
+
+Usage: uni_step_rate.py [--config Marlin] [--max-rate HZ] file.gcode
+"""
+
+import argparse, math, re
+from pathlib import Path
+
+AXES = 'XYZE'
+MODES = (1, 2, 4, 8, 16, 32)
+
+def config_value(text, name):
+    m = re.search(r'^\s*#define\s+' + name + r'\s+(.+?)\s*(?://.*)?$', text, re.M)
+    return m.group(1) if m else None
+
+def config_array(text, name):
+    v = config_value(text, name)
+    return [ float(x) for x in v.strip('{} ').split(',') ] if v else None
+
+class Modal:
+    """G-code state carried from line to line: position, feedrate, distance modes and motion mode."""
+    def __init__(self):
+        self.pos, self.feed, self.motion = [0.0] * 4, 50.0, None
+        self.absolute = self.e_absolute = True
+
+def line_moves(line, state, max_arc_segment):
+    """Yield (delta[4], feedrate_mm_s) for one G-code line, splitting arcs into chords.
+
+    Lines with axis words and no G word repeat the last G0-G3, as with GCODE_MOTION_MODES.
+    """
+    line = line.split(';', 1)[0].strip().upper()
+    if not line: return
+    words = dict((w[0], float(w[1:])) for w in re.findall(r'[A-Z][-+]?[0-9.]+', line))
+    g = words.get('G')
+    if 'M' in words and 'G' not in words:
+        if words['M'] == 82: state.e_absolute = True
+        if words['M'] == 83: state.e_absolute = False
+        return
+    if g == 90: state.absolute = state.e_absolute = True
+    elif g == 91: state.absolute = state.e_absolute = False
+    elif g == 92:
+        for i, a in enumerate(AXES):
+            if a in words: state.pos[i] = words[a]
+    if g in (0, 1, 2, 3): state.motion = g
+    elif g is not None or state.motion is None: return
+    else: g = state.motion
+    pos = state.pos
+    if 'F' in words: state.feed = words['F'] / 60.0
+    target = list(pos)
+    for i, a in enumerate(AXES):
+        if a in words:
+            rel = not (state.e_absolute if a == 'E' else state.absolute)
+            target[i] = pos[i] + words[a] if rel else words[a]
+    if g in (0, 1):
+        if target != pos: yield [ t - p for t, p in zip(target, pos) ], state.feed
+    else:
+        cx, cy = pos[0] + words.get('I', 0.0), pos[1] + words.get('J', 0.0)
+        a0 = math.atan2(pos[1] - cy, pos[0] - cx)
+        a1 = math.atan2(target[1] - cy, target[0] - cx)
+        sweep = a1 - a0
+        if g == 2 and sweep >= 0: sweep -= 2 * math.pi
+        if g == 3 and sweep <= 0: sweep += 2 * math.pi
+        r = math.hypot(pos[0] - cx, pos[1] - cy)
+        if not r: return                                # No I/J offset: Marlin rejects the arc
+        n = max(1, int(math.ceil(abs(sweep) * r / max_arc_segment)))
+        prev = list(pos)
+        for k in range(1, n + 1):
+            t = k / n
+            p = [ cx + r * math.cos(a0 + sweep * t), cy + r * math.sin(a0 + sweep * t),
+                  pos[2] + (target[2] - pos[2]) * t, pos[3] + (target[3] - pos[3]) * t ]
+            yield [ a - b for a, b in zip(p, prev) ], state.feed
+            prev = p
+    state.pos = target
+
+def moves(path, max_arc_segment):
+    """Yield (delta[4], feedrate_mm_s) for each linear move, splitting arcs into chords."""
+    state = Modal()
+    for raw in Path(path).read_text(errors='ignore').splitlines():
+        yield from line_moves(raw, state, max_arc_segment)
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('gcode')
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h')
+    ap.add_argument('--max-rate', type=float, help='step ISR limit to check against (Hz)')
+    args = ap.parse_args()
+
+    text = Path(args.config, 'Configuration.h').read_text(errors='ignore')
+    adv = Path(args.config, 'Configuration_adv.h').read_text(errors='ignore')
+    steps = config_array(text, 'DEFAULT_AXIS_STEPS_PER_UNIT')[:4]
+    max_feed = config_array(text, 'DEFAULT_MAX_FEEDRATE')[:4]
+    base_modes = (config_array(adv, 'MICROSTEP_MODES') or [16] * 4)[:4]
+    max_arc_segment = float(config_value(adv, 'MAX_ARC_SEGMENT_MM') or 1.0)
+    max_rate = args.max_rate or float(config_value(adv, 'MAXIMUM_STEPPER_RATE') or 0)
+
+    # Peak per-axis speed (mm/s) and peak combined speed weighted by steps/mm
+    peak = [0.0] * 4
+    peak_combined = []
+    for delta, feed in moves(args.gcode, max_arc_segment):
+        dist = math.sqrt(sum(d * d for d in delta[:3])) or abs(delta[3])
+        if dist == 0: continue
+        v = [ abs(d) / dist * feed for d in delta ]
+        scale = min([1.0] + [ max_feed[i] / v[i] for i in range(4) if v[i] > max_feed[i] ])
+        v = [ x * scale for x in v ]
+        peak = [ max(p, x) for p, x in zip(peak, v) ]
+        peak_combined.append(v)
+
+    print('%6s' % 'Mode' + ''.join('%12s' % (a + ' (Hz)') for a in AXES) + '%14s' % 'All (Hz)')
+    for mode in MODES:
+        spu = [ s * mode / b for s, b in zip(steps, base_modes) ]
+        rates = [ p * s for p, s in zip(peak, spu) ]
+        combined = max((sum(x * s for x, s in zip(v, spu)) for v in peak_combined), default=0)
+        flag = '  > limit' if max_rate and combined > max_rate else ''
+        print('%6d' % mode + ''.join('%12.0f' % r for r in rates) + '%14.0f' % combined + flag)
+
+if __name__ == '__main__':
+    main()
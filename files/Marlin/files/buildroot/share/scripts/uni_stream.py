@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""
+uni_stream.py
+
+USB streaming benchmark for the STM32F401CCU6 UNI.
+
+Streams a G-code file to the board and reports lines per second, the "ok"
+round-trip time, how many "busy:" messages came back and how often the
+planner ran dry. Run it on a dry-run job (e.g. with M302 / no heaters) to
+measure the serial path on its own.
+
+Two modes are available:
+  default   One line in flight, like OctoPrint (optionally with N/checksum).
+  --credit  Keep sending while the command queue has room. The capacity is
+            taken from the ADVANCED_OK "B" field of the first reply and the
+            bytes in flight are limited to --rx-bytes (Grbl-style counting).
+
+Starvation is counted from the ADVANCED_OK "P" field: an "ok" reporting every
+planner block free after motion has started means the planner ran empty.
+
+Requires pyserial.
+
+Usage: uni_stream.py --port /dev/ttyACM0 [--baud 250000] [--checksum] [--credit] file.gcode
+"""
+
+import argparse, re, time
+from collections import deque
+import serial
+
+def gcode_lines(path):
+    for raw in open(path, errors='ignore'):
+        line = raw.split(';', 1)[0].strip()
+        if line: yield line
+
+def with_checksum(n, line):
+    cmd = 'N%d %s' % (n, line)
+    cs = 0
+    for c in cmd.encode(): cs ^= c
+    return '%s*%d' % (cmd, cs)
+
+class Stats:
+    def __init__(self):
+        self.lines = self.busy = self.starved = 0
+        self.rtt = []
+        self.planner_size = None
+        self.moving = False
+
+    def advanced_ok(self, reply):
+        """Track planner starvation from an 'ok N.. P.. B..' reply. Return B or None."""
+        p = re.search(r'\bP(\d+)', reply)
+        b = re.search(r'\bB(\d+)', reply)
+        if p:
+            free = int(p.group(1))
+            if self.planner_size is None or free > self.planner_size: self.planner_size = free
+            if free < self.planner_size: self.moving = True
+            elif self.moving:
+                self.starved += 1
+                self.moving = False
+        return int(b.group(1)) if b else None
+
+    def report(self, elapsed):
+        print('%d lines in %.2f s: %.1f lines/s' % (self.lines, elapsed, self.lines / elapsed if elapsed else 0))
+        if self.rtt:
+            self.rtt.sort()
+            print('ok round-trip: avg %.2f ms, p99 %.2f ms, max %.2f ms' % (
+                1000 * sum(self.rtt) / len(self.rtt), 1000 * self.rtt[int(len(self.rtt) * 0.99)], 1000 * self.rtt[-1]))
+        print('busy messages: %d' % self.busy)
+        if self.planner_size is not None:
+            print('planner starvation events: %d' % self.starved)
+        else:
+            print('planner starvation: unknown (enable ADVANCED_OK)')
+
+def wait_ok(port, stats):
+    while True:
+        reply = port.readline().decode(errors='ignore').strip()
+        if not reply: raise TimeoutError('no reply from board')
+        if reply.startswith('ok'): return reply
+        if 'busy:' in reply: stats.busy += 1         # echo:busy: processing
+        if reply.startswith('Error:'): print(reply)
+
+def send(port, n, line, checksum):
+    data = ((with_checksum(n, line) if checksum else line) + '\n').encode()
+    port.write(data)
+    return len(data)
+
+def stream(port, lines, checksum, stats):
+    for n, line in enumerate(lines, 1):
+        t = time.perf_counter()
+        send(port, n, line, checksum)
+        stats.advanced_ok(wait_ok(port, stats))
+        stats.rtt.append(time.perf_counter() - t)
+        stats.lines += 1
+
+def stream_credit(port, lines, checksum, stats, rx_bytes, capacity):
+    in_flight = deque()                 # (bytes, time sent) per unacknowledged line
+    pending = deque(enumerate(lines, 1))
+    while pending or in_flight:
+        while pending and len(in_flight) < capacity:
+            n, line = pending[0]
+            size = len(with_checksum(n, line) if checksum else line) + 1
+            if in_flight and sum(s for s, _ in in_flight) + size > rx_bytes: break
+            pending.popleft()
+            in_flight.append((send(port, n, line, checksum), time.perf_counter()))
+        reply = wait_ok(port, stats)
+        stats.advanced_ok(reply)
+        stats.rtt.append(time.perf_counter() - in_flight.popleft()[1])
+        stats.lines += 1
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('gcode')
+    ap.add_argument('--port', required=True)
+    ap.add_argument('--baud', type=int, default=250000)
+    ap.add_argument('--checksum', action='store_true', help='send N<line> ... *<checksum> like OctoPrint')
+    ap.add_argument('--credit', action='store_true', help='keep the command queue full using ADVANCED_OK')
+    ap.add_argument('--rx-bytes', type=int, default=127, help='bytes allowed in flight in --credit mode')
+    args = ap.parse_args()
+
+    stats = Stats()
+    with serial.Serial(args.port, args.baud, timeout=10) as port:
+        time.sleep(2)
+        port.reset_input_buffer()
+        port.write(b'M110 N0\n')
+        capacity = stats.advanced_ok(wait_ok(port, stats))
+        if args.credit and not capacity:
+            raise SystemExit('--credit needs ADVANCED_OK enabled in the firmware')
+        start = time.perf_counter()
+        if args.credit:
+            stream_credit(port, gcode_lines(args.gcode), args.checksum, stats, args.rx_bytes, capacity)
+        else:
+            stream(port, gcode_lines(args.gcode), args.checksum, stats)
+        stats.report(time.perf_counter() - start)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,412 @@
+#!/usr/bin/env python3
+"""
+uni_thermal_sim.py
+
+Hotend and bed thermal simulator for the STM32F401CCU6 UNI.
+
+Heats a modeled hotend (24 V cartridge switched by the UNI heater MOSFET) from
+ambient to a target and compares Marlin's PID and MPC controllers, using the
+constants from Marlin/Configuration.h. Reports time to reach the target window
+(TEMP_WINDOW held for TEMP_RESIDENCY_TIME, as M109 waits) and the overshoot.
+
+--tune runs an M306 T style autotune against the plant: full power heat-up
+from ambient, an asymptotic fit of the curve, then prints MPC constants.
+
+--suite runs a regression suite of hotend and bed scenarios. Temperatures are
+read back through the UNI 1kΩ divider on PB1/PB0 (12-bit ADC, OVERSAMPLENR
+samples with noise) and checked the way Marlin does: MINTEMP/MAXTEMP, the
+WATCH_TEMP_PERIOD heating check and the THERMAL_PROTECTION_PERIOD runaway
+check, with AUTOTEMP driving the hotend target in one scenario. Each scenario
+reports heat-up time, stability, protection trips and host time per control
+tick, and the exit status is 1 if any scenario does not match its expected
+outcome.
+
+The hotend plant is built from the hardware, not from the MPC_* constants:
+an E3D V6 class aluminium block with a brass nozzle and the 40 W cartridge
+from MPC_HEATER_POWER (see HOTEND). Cartridge and block are separate heat
+capacities joined by the contact conductance of the bore, and the block loses
+heat by natural convection, radiation and conduction up the heatbreak. The
+MPC_* constants in Configuration.h are the --tune fit against this plant.
+Any --plant-* option replaces it with a one-node block of those values, to
+model a different hotend or a mis-tuned controller.
+
+Usage: uni_thermal_sim.py [--target 210] [--tune] [--suite] [--plant-power 40] ...
+"""
+
+import argparse, math, random, re, time
+from pathlib import Path
+from uni_thermistor import adc, temp_from_adc, ADC_MAX
+
+class Config:
+    """#define lookup in Configuration.h and Configuration_adv.h, tolerating '{ 16.7f }' arrays and trailing comments."""
+    def __init__(self, path):
+        self.text = ''.join(Path(path, f).read_text(errors='ignore') for f in ('Configuration.h', 'Configuration_adv.h'))
+
+    def get(self, name, default=None, index=0):
+        m = re.search(r'^\s*#define\s+' + name + r'\s+([^/\n]+)', self.text, re.M)
+        if not m: return default
+        v = m.group(1).strip().strip('{} ').split(',')[index].strip().rstrip('fUL')
+        try: return float(v)
+        except ValueError: return default
+
+class Heater:
+    """Heater block with losses to ambient, and a sensor lagging the block.
+    'load' is extra loss (W/K) from the part fan or extrusion; a 'detached' sensor
+    has fallen out of the block and relaxes to ambient."""
+    def __init__(self, power, capacity, xfer, responsiveness, ambient=25.0):
+        self.power, self.capacity, self.xfer, self.resp = power, capacity, xfer, responsiveness
+        self.ambient = ambient
+        self.block = self.sensor = ambient
+        self.load, self.detached = 0.0, False
+
+    def step(self, duty, dt):
+        self.block += (duty * self.power - (self.block - self.ambient) * (self.xfer + self.load)) * dt / self.capacity
+        self.sensor += ((self.ambient if self.detached else self.block) - self.sensor) * self.resp * dt
+        return self.sensor
+
+# Physical E3D V6 class hotend behind the default plant. Heat capacities are mass x specific heat;
+# surface and heatbreak figures are from the part drawings.
+HOTEND = dict(
+    block_j_k = 2.8 * 2.70 * 0.897 + 2.4 * 0.380 + 0.4,    # 2.8 cm³ aluminium block, 2.4 g brass nozzle, heatbreak and screws
+    cartridge_j_k = 3.5 * 0.50,                             # 6 x 20 mm cartridge, 3.5 g of steel sheath, MgO and NiCr
+    cartridge_w_k = 0.8,                                    # (W/K) cartridge to block, clamped in its bore without paste
+    area_m2 = 1.6e-3,                                       # block 16 x 20 x 11.5 mm plus nozzle surface
+    h_conv = 12.0,                                          # (W/m²K) natural convection
+    h_fan = 40.0,                                           # (W/m²K) forced convection with the part fan at 255
+    emissivity = 0.1,                                       # bare machined aluminium
+    break_w_k = 0.023,                                      # (W/K) stainless heatbreak throat, 16 W/mK x 3.0 mm² / 2.1 mm
+    sensor_tau = 4.5,                                       # (s) glass bead thermistor in a 3 mm bore
+)
+SIGMA = 5.67e-8
+
+class Hotend(Heater):
+    """The HOTEND hardware: the heater drives the cartridge, which heats the block through the bore;
+    the block loses heat by convection, radiation (T⁴) and the heatbreak, and the sensor lags the block."""
+    def __init__(self, power, hw=HOTEND, ambient=25.0):
+        super().__init__(power, hw['block_j_k'], hw['area_m2'] * hw['h_conv'] + hw['break_w_k'], 1.0 / hw['sensor_tau'], ambient)
+        self.hw, self.cartridge = hw, ambient
+        self.fan_load = hw['area_m2'] * (hw['h_fan'] - hw['h_conv'])
+
+    def step(self, duty, dt):
+        hw = self.hw
+        flow = (self.cartridge - self.block) * hw['cartridge_w_k']
+        self.cartridge += (duty * self.power - flow) * dt / hw['cartridge_j_k']
+        radiation = hw['emissivity'] * SIGMA * hw['area_m2'] * ((self.block + 273.15) ** 4 - (self.ambient + 273.15) ** 4)
+        self.block += (flow - radiation - (self.block - self.ambient) * (self.xfer + self.load)) * dt / self.capacity
+        self.sensor += ((self.ambient if self.detached else self.block) - self.sensor) * self.resp * dt
+        return self.sensor
+
+class PID:
+    """Marlin's hotend PID: functional range, clamped I term, filtered D term."""
+    def __init__(self, cfg, dt):
+        self.kp = cfg.get('DEFAULT_Kp')
+        self.ki = cfg.get('DEFAULT_Ki') * dt
+        self.kd = cfg.get('DEFAULT_Kd') / dt
+        self.k2 = 1.0 - cfg.get('PID_K1', 0.95)
+        self.max = cfg.get('PID_MAX', 255)
+        self.range = cfg.get('PID_FUNCTIONAL_RANGE', 10)
+        self.reset = True
+        self.i_state = self.d_term = self.d_state = 0.0
+
+    def output(self, target, temp):
+        err = target - temp
+        if err > self.range:
+            self.reset = True
+            return self.max
+        if err < -self.range:
+            self.reset = True
+            return 0
+        if self.reset:
+            self.i_state = self.d_term = 0.0
+            self.d_state = temp
+            self.reset = False
+        self.i_state = min(max(self.i_state + err, 0), self.max / self.ki)
+        self.d_term += self.k2 * (self.kd * (self.d_state - temp) - self.d_term)
+        self.d_state = temp
+        return min(max(self.kp * err + self.ki * self.i_state + self.d_term, 0), self.max)
+
+class MPC:
+    """Marlin's model predictive control: model the block, plan power to reach target in 2 s."""
+    def __init__(self, cfg, dt):
+        self.dt = dt
+        self.power = cfg.get('MPC_HEATER_POWER')
+        self.capacity = cfg.get('MPC_BLOCK_HEAT_CAPACITY')
+        self.resp = cfg.get('MPC_SENSOR_RESPONSIVENESS')
+        self.xfer = cfg.get('MPC_AMBIENT_XFER_COEFF')
+        self.max = cfg.get('MPC_MAX', 255)
+        self.smoothing = cfg.get('MPC_SMOOTHING_FACTOR', 0.5)
+        self.min_ambient_change = cfg.get('MPC_MIN_AMBIENT_CHANGE', 1.0)
+        self.steadystate = cfg.get('MPC_STEADYSTATE', 0.5)
+        self.block = None
+        self.last = self.load = 0.0
+
+    def output(self, target, temp):
+        if self.block is None:
+            self.ambient = min(30.0, temp)
+            self.block = self.sensor = temp
+        xfer = self.xfer + self.load
+        block_delta = (self.last / 255.0 * self.power - (self.block - self.ambient) * xfer) * self.dt / self.capacity
+        self.block += block_delta
+        self.sensor += (self.block - self.sensor) * self.resp * self.dt
+        correction = (temp - self.sensor) * self.smoothing
+        self.block += correction
+        self.sensor += correction
+        if 0 < self.last < self.max or abs(block_delta + correction) < self.steadystate * self.dt:
+            step = self.min_ambient_change * self.dt
+            self.ambient += max(correction, step) if correction > 0 else min(correction, -step)
+        power = (target - self.block) * self.capacity / 2.0 + (target - self.ambient) * xfer
+        self.last = min(max(power * 255.0 / self.power, 0), self.max)
+        return self.last
+
+class BangBang:
+    """Marlin's bed control without PIDTEMPBED: on below target, re-evaluated every BED_CHECK_INTERVAL."""
+    def __init__(self, cfg, dt):
+        self.max = cfg.get('MAX_BED_POWER', 255)
+        self.interval = cfg.get('BED_CHECK_INTERVAL', 5000) / 1000.0
+        self.dt, self.elapsed, self.last = dt, float('inf'), 0
+        self.load = 0.0
+
+    def output(self, target, temp):
+        self.elapsed += self.dt
+        if self.elapsed >= self.interval:
+            self.elapsed = 0.0
+            self.last = self.max if temp < target else 0
+        return self.last
+
+class Thermistor:
+    """UNI 1kΩ divider into the 12-bit ADC: OVERSAMPLENR noisy samples per reading, converted back as table 51 does."""
+    def __init__(self, rng, noise, oversample=16, r25=100000, beta=4092, pullup=1000):
+        self.rng, self.noise, self.oversample = rng, noise, oversample
+        self.r25, self.beta, self.pullup = r25, beta, pullup
+
+    def read(self, t):
+        ideal = adc(t, self.r25, self.beta, self.pullup)
+        raw = sum(min(max(round(self.rng.gauss(ideal, self.noise)), 0), ADC_MAX) for _ in range(self.oversample))
+        return temp_from_adc(raw / self.oversample, self.r25, self.beta, self.pullup)
+
+class Protection:
+    """Marlin's heater checks: MINTEMP/MAXTEMP, the WATCH heating check and the thermal runaway state machine."""
+    def __init__(self, mintemp, maxtemp, period, hysteresis, watch_period, watch_increase, temp_hysteresis):
+        self.mintemp, self.maxtemp = mintemp, maxtemp
+        self.period, self.hysteresis = period, hysteresis
+        self.watch_period, self.watch_increase, self.temp_hysteresis = watch_period, watch_increase, temp_hysteresis
+        self.watch = self.tr_target = None
+        self.state, self.timer = 'inactive', 0.0
+
+    def start_watching(self, target, temp, now):
+        if temp < target - (self.watch_increase + self.temp_hysteresis + 1):
+            self.watch = (temp + self.watch_increase, now + self.watch_period)
+        else:
+            self.watch = None
+
+    def check(self, target, temp, now):
+        """Return the error Marlin would halt with, or None."""
+        if temp >= self.maxtemp: return 'MAXTEMP'
+        if temp <= self.mintemp: return 'MINTEMP'
+        if self.watch and now >= self.watch[1]:
+            if temp < self.watch[0]: return 'Heating failed'
+            self.start_watching(target, temp, now)
+        if target != self.tr_target:
+            self.tr_target, self.state = target, 'first' if target > 0 else 'inactive'
+        if self.state == 'inactive': return None
+        if self.state == 'first':
+            if temp < target: return None
+            self.state = 'stable'
+        if temp >= target - self.hysteresis:
+            self.timer = now + self.period
+        elif now >= self.timer:
+            return 'Thermal runaway'
+        return None
+
+def heat_up(controller, plant, target, dt, window, residency, duration):
+    """Return (seconds until M109 would finish or None, overshoot in K)."""
+    t, temp, peak, since = 0.0, plant.sensor, plant.sensor, None
+    while t < duration:
+        temp = plant.step(controller.output(target, temp) / 255.0, dt)
+        t += dt
+        peak = max(peak, temp)
+        if abs(temp - target) <= window:
+            if since is None: since = t
+            if t - since >= residency: return since, peak - target
+        else:
+            since = None
+    return None, peak - target
+
+def autotune(plant, dt, target):
+    """M306 T style: full power heat-up, fit an exponential to three samples, derive MPC constants,
+    then hold the target with the fan at 255 and take the fan coefficient from the average power."""
+    ambient, t, samples = plant.sensor, 0.0, []
+    while plant.sensor < target:
+        plant.step(1.0, dt)
+        t += dt
+        samples.append((t, plant.sensor))
+    # Three equally spaced samples from the upper half of the curve, past the sensor lag
+    k = len(samples) // 4
+    (t1, y1), (t2, y2), (t3, y3) = samples[-1 - 2 * k], samples[-1 - k], samples[-1]
+    span = t2 - t1
+    asymptote = (y1 * y3 - y2 * y2) / (y1 + y3 - 2 * y2)
+    tau = span / math.log((asymptote - y1) / (asymptote - y2))
+    xfer = plant.power / (asymptote - ambient)
+    capacity = xfer * tau
+    # Sensor lag: the sensor curve's amplitude exceeds the block's by tau / (tau - tau_s)
+    amplitude = (asymptote - y1) * math.exp(t1 / tau)
+    lag = tau * (1.0 - (asymptote - ambient) / amplitude)
+    plant.load = getattr(plant, 'fan_load', 0.0)
+    energy = held = 0.0
+    for k in range(int(120 / dt)):
+        duty = 1.0 if plant.sensor < target else 0.0
+        plant.step(duty, dt)
+        if k * dt >= 60: energy, held = energy + duty * plant.power * dt, held + dt
+    return { 'MPC_BLOCK_HEAT_CAPACITY': capacity, 'MPC_AMBIENT_XFER_COEFF': xfer,
+             'MPC_SENSOR_RESPONSIVENESS': 1.0 / lag if lag > 0 else float('inf'),
+             'MPC_AMBIENT_XFER_COEFF_FAN255': energy / held / (plant.block - ambient) }
+
+def run_scenario(sc, ctrl, plant, sensor, guard, dt, window, residency):
+    """Run one scenario. Returns settle time, overshoot, worst deviation once settled and back at a changed target, trip and µs per tick."""
+    t, temp, target = 0.0, sensor.read(plant.sensor), sc['target']
+    guard.start_watching(target, temp, 0.0)
+    since = settled = trip = None
+    peak, worst, busy, ticks, reached = temp, 0.0, 0.0, 0, False
+    while t < sc['duration'] and not trip:
+        if 'event' in sc:
+            new_target = sc['event'](t, plant, ctrl) or target
+            if abs(new_target - target) > 0.01: reached = False
+            target = new_target
+        tick = time.perf_counter()
+        temp = sensor.read(plant.sensor)
+        duty = ctrl.output(target, temp)
+        busy += time.perf_counter() - tick
+        ticks += 1
+        plant.step(duty / 255.0, dt)
+        t += dt
+        error = guard.check(target, temp, t)
+        if error: trip = (error, t)
+        if settled is None:
+            peak = max(peak, temp)
+            if abs(temp - target) <= window:
+                if since is None: since = t
+                if t - since >= residency: settled = since
+            else:
+                since = None
+        else:
+            reached = reached or abs(temp - target) <= window
+            if reached: worst = max(worst, abs(temp - target))
+    return settled, peak - sc['target'], worst, trip, 1e6 * busy / ticks
+
+def scenarios(cfg, args):
+    """Each scenario: heater, target, duration, optional event(t, plant, ctrl) that may return a new target, expected trip."""
+    fan_load = cfg.get('MPC_AMBIENT_XFER_COEFF_FAN255', 0.097) - cfg.get('MPC_AMBIENT_XFER_COEFF', 0.068)
+    filament = cfg.get('FILAMENT_HEAT_CAPACITY_PERMM', 5.6e-3)
+    e_steps = cfg.get('DEFAULT_AXIS_STEPS_PER_UNIT', 500, index=3)
+
+    def fan_on(t, plant, ctrl):
+        if t >= 200: plant.load, ctrl.load = getattr(plant, 'fan_load', fan_load), fan_load
+
+    def heater_dead(t, plant, ctrl):
+        plant.power = 0.0
+
+    def sensor_out(t, plant, ctrl):
+        if t >= 200: plant.detached = True
+
+    autotemp = { 'old': 0.0 }
+    def autotemp_print(t, plant, ctrl):
+        # M104 S<min> B<max> F<factor>; infill at 3 mm/s of filament alternating with perimeters at 0.5 mm/s
+        e_speed = 0.0 if t < 150 else 3.0 if int(t / 20) % 2 else 0.5
+        plant.load = ctrl.load = e_speed * filament
+        target = min(max(args.autotemp_min + e_speed * e_steps * args.autotemp_factor, args.autotemp_min), args.autotemp_max)
+        if target < autotemp['old']:
+            weight = cfg.get('AUTOTEMP_OLDWEIGHT', 0.98)
+            target = target * (1.0 - weight) + autotemp['old'] * weight
+        autotemp['old'] = target
+        return target
+
+    return [
+        dict(name='hotend heat-up',        heater='hotend', target=args.target, duration=300, expect=None),
+        dict(name='hotend part fan 100%',  heater='hotend', target=args.target, duration=400, event=fan_on, expect=None),
+        dict(name='hotend AUTOTEMP print', heater='hotend', target=args.autotemp_min, duration=400, event=autotemp_print, expect=None),
+        dict(name='hotend heater failure', heater='hotend', target=args.target, duration=120, event=heater_dead, expect='Heating failed'),
+        dict(name='hotend thermistor out', heater='hotend', target=args.target, duration=400, event=sensor_out, expect='Thermal runaway'),
+        dict(name='bed heat-up',           heater='bed', target=args.bed_target, duration=600, expect=None),
+        dict(name='bed heater failure',    heater='bed', target=args.bed_target, duration=180, event=heater_dead, expect='Heating failed'),
+    ]
+
+def suite(cfg, args, power):
+    rng = random.Random(args.seed)
+    oversample = int(cfg.get('OVERSAMPLENR', 16))
+    hotend_guard = lambda: Protection(cfg.get('HEATER_0_MINTEMP', 5), cfg.get('HEATER_0_MAXTEMP', 275),
+        cfg.get('THERMAL_PROTECTION_PERIOD', 40), cfg.get('THERMAL_PROTECTION_HYSTERESIS', 4),
+        cfg.get('WATCH_TEMP_PERIOD', 40), cfg.get('WATCH_TEMP_INCREASE', 2), cfg.get('TEMP_HYSTERESIS', 3))
+    bed_guard = lambda: Protection(cfg.get('BED_MINTEMP', 5), cfg.get('BED_MAXTEMP', 150),
+        cfg.get('THERMAL_PROTECTION_BED_PERIOD', 20), cfg.get('THERMAL_PROTECTION_BED_HYSTERESIS', 2),
+        cfg.get('WATCH_BED_TEMP_PERIOD', 60), cfg.get('WATCH_BED_TEMP_INCREASE', 2), cfg.get('TEMP_BED_HYSTERESIS', 3))
+    heaters = {
+        'hotend': (lambda: hotend_plant(args, power), hotend_guard,
+                   (('PID', PID), ('MPC', MPC)), cfg.get('TEMP_WINDOW', 1), cfg.get('TEMP_RESIDENCY_TIME', 10)),
+        'bed':    (lambda: Heater(args.bed_power, args.bed_capacity, args.bed_xfer, args.bed_resp), bed_guard,
+                   (('bang', BangBang),), cfg.get('TEMP_BED_WINDOW', 1), cfg.get('TEMP_BED_RESIDENCY_TIME', 10)),
+    }
+    print('%-22s %-5s %10s %10s %10s %22s %9s  %s' % ('Scenario', 'Ctrl', 'Settled', 'Overshoot', 'Max dev', 'Trip', 'µs/tick', 'Result'))
+    failed = 0
+    for sc in scenarios(cfg, args):
+        make_plant, make_guard, controllers, window, residency = heaters[sc['heater']]
+        for name, ctrl_class in controllers:
+            settled, overshoot, worst, trip, us = run_scenario(sc, ctrl_class(cfg, args.dt), make_plant(),
+                Thermistor(rng, args.adc_noise, oversample), make_guard(), args.dt, window, residency)
+            ok = (trip[0] if trip else None) == sc['expect']
+            failed += not ok
+            print('%-22s %-5s %10s %9.2fK %9.2fK %22s %9.1f  %s' % (sc['name'], name,
+                ('%.1f s' % settled) if settled is not None else '-', max(overshoot, 0), worst,
+                ('%s @ %.0f s' % trip) if trip else '-', us, 'ok' if ok else 'FAIL (expected %s)' % sc['expect']))
+    return failed
+
+def hotend_plant(args, power):
+    """The physical hotend, or a one-node block when any --plant-* value is given."""
+    if args.plant_capacity is None and args.plant_xfer is None and args.plant_resp is None: return Hotend(power)
+    return Heater(power, args.plant_capacity or HOTEND['block_j_k'] + HOTEND['cartridge_j_k'],
+        args.plant_xfer or HOTEND['area_m2'] * HOTEND['h_conv'] + HOTEND['break_w_k'], args.plant_resp or 1.0 / HOTEND['sensor_tau'])
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('--config', default='Marlin', help='directory holding Configuration.h')
+    ap.add_argument('--target', type=float, default=210)
+    ap.add_argument('--dt', type=float, default=0.064, help='temperature update period (s)')
+    ap.add_argument('--duration', type=float, default=600)
+    ap.add_argument('--tune', action='store_true', help='autotune MPC against the plant')
+    ap.add_argument('--plant-power', type=float, help='heater power (W), default MPC_HEATER_POWER')
+    ap.add_argument('--plant-capacity', type=float, help='one-node block heat capacity (J/K)')
+    ap.add_argument('--plant-xfer', type=float, help='one-node block loss to ambient (W/K)')
+    ap.add_argument('--plant-resp', type=float, help='one-node sensor responsiveness (1/s)')
+    ap.add_argument('--suite', action='store_true', help='run the hotend and bed regression suite')
+    ap.add_argument('--bed-target', type=float, default=60)
+    ap.add_argument('--bed-power', type=float, default=220, help='bed heater power (W)')
+    ap.add_argument('--bed-capacity', type=float, default=600, help='bed heat capacity (J/K)')
+    ap.add_argument('--bed-xfer', type=float, default=1.0, help='bed loss to ambient (W/K)')
+    ap.add_argument('--bed-resp', type=float, default=0.1, help='bed sensor responsiveness (1/s)')
+    ap.add_argument('--autotemp-min', type=float, default=200, help='M104 S')
+    ap.add_argument('--autotemp-max', type=float, default=240, help='M104 B')
+    ap.add_argument('--autotemp-factor', type=float, default=0.02, help='M104 F (°C per E step/s)')
+    ap.add_argument('--adc-noise', type=float, default=2.0, help='ADC noise (counts RMS)')
+    ap.add_argument('--seed', type=int, default=1)
+    args = ap.parse_args()
+
+    cfg = Config(args.config)
+    power = args.plant_power or cfg.get('MPC_HEATER_POWER', 40.0)
+    make_plant = lambda: hotend_plant(args, power)
+
+    if args.tune:
+        for name, value in autotune(make_plant(), args.dt, args.target).items():
+            print('#define %-29s { %.3ff }' % (name, value))
+        return
+
+    if args.suite:
+        raise SystemExit(1 if suite(cfg, args, power) else 0)
+
+    window = cfg.get('TEMP_WINDOW', 1)
+    residency = cfg.get('TEMP_RESIDENCY_TIME', 10)
+    print('Heat-up 25 -> %.0f °C, %.0f W heater, M109 window ±%g °C for %g s' % (args.target, power, window, residency))
+    for name, ctrl in (('PID', PID(cfg, args.dt)), ('MPC', MPC(cfg, args.dt))):
+        done, overshoot = heat_up(ctrl, make_plant(), args.target, args.dt, window, residency, args.duration)
+        print('%-4s %s, overshoot %.2f K' % (name, ('%.1f s' % done) if done else 'never settles', max(overshoot, 0)))
+
+if __name__ == '__main__':
+    main()
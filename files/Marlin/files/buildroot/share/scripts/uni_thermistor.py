@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""
+uni_thermistor.py
+
+Thermistor divider model for the STM32F401CCU6 UNI.
+
+The UNI measures TEMP_0_PIN (PB1) and TEMP_BED_PIN (PB0) through 1kΩ pull-ups
+(R501, R502) instead of the usual 4.7kΩ. For each temperature this prints the
+12-bit ADC reading, the resolution in °C per ADC count with each pull-up, and
+the error Marlin would report if the 4.7kΩ table (TEMP_SENSOR 1) were used on
+the 1kΩ divider instead of the matching table 51.
+
+With --lut BITS it instead builds an evenly indexed fixed-point table for the
+1kΩ divider (index = raw >> (12 - BITS), value = °C * 2^FRAC), so conversion
+is a shift, one subtraction and one multiply with no table search. It reports
+the worst interpolation error against the model over HEATER_0_MINTEMP ..
+HEATER_0_MAXTEMP and, with --emit, prints the table as C.
+
+The table is compared with the path Marlin uses today: table 51, read from
+src/module/thermistor/thermistor_51.h of the Marlin tree (--table), searched
+and interpolated the way analog_to_celsius() does it. Both are checked
+against the model, and against each other, at every 0.1 °C over the same
+range. For the cost, the search steps of each reading are counted and both
+lookups are converted to Cortex-M4 cycles: a flash load is 1 + --flash-ws
+cycles, VDIV 14, other ALU, VFP and branch instructions 1 to 3. The host
+time of both implementations is given as well, as a cross-check.
+
+The default thermistor is the 100kΩ EPCOS B57560G104F behind tables 1 and 51.
+
+Usage: uni_thermistor.py [--r25 100000] [--beta 4092] [--pullup 1000] [--lut 8 [--emit] [--table thermistor_51.h]]
+"""
+
+import argparse, math, re, timeit
+from pathlib import Path
+from uni_step_rate import config_value
+
+ADC_MAX = 4095          # ADC_RESOLUTION 12
+T0 = 298.15             # 25°C in K
+TABLE_SCALE = 4         # THERMISTOR_TABLE_SCALE: the tables are written for a 10-bit ADC
+F_CPU = 84e6
+
+def resistance(t, r25, beta):
+    return r25 * math.exp(beta * (1.0 / (t + 273.15) - 1.0 / T0))
+
+def adc(t, r25, beta, pullup):
+    r = resistance(t, r25, beta)
+    return ADC_MAX * r / (r + pullup)
+
+def temp_from_adc(raw, r25, beta, pullup):
+    raw = min(max(raw, 1e-6), ADC_MAX - 1e-6)
+    r = pullup * raw / (ADC_MAX - raw)
+    return 1.0 / (1.0 / T0 + math.log(r / r25) / beta) - 273.15
+
+def build_lut(bits, frac, r25, beta, pullup):
+    """Evenly indexed table: entry i is the temperature at raw = i << (12 - bits)."""
+    step = (ADC_MAX + 1) >> bits
+    lut = []
+    for i in range((1 << bits) + 1):
+        t = temp_from_adc(min(i * step, ADC_MAX), r25, beta, pullup)
+        lut.append(int(round(min(max(t, -50), 500) * (1 << frac))))
+    return lut, step
+
+def lut_lookup(lut, step, frac, raw):
+    """Fixed-point interpolation, as the firmware would do it."""
+    shift = step.bit_length() - 1
+    i, f = raw >> shift, raw & (step - 1)
+    return (lut[i] + (((lut[i + 1] - lut[i]) * f) >> shift)) / (1 << frac)
+
+def lut_cycles(ws):
+    """LSR, AND, two LDRSH, SUB, MUL, ASR, ADD, plus call and return."""
+    return 2 * (1 + ws) + 6 + 4
+
+def marlin_table(path):
+    """(raw 12-bit, °C) pairs of a Marlin thermistor table, in table order (raw ascending)."""
+    pairs = re.findall(r'\{\s*OV\(\s*(-?\d+)\s*\)\s*,\s*(-?\d+)\s*\}', Path(path).read_text(errors='ignore'))
+    return [ (int(v) * TABLE_SCALE, int(c)) for v, c in pairs ]
+
+def marlin_lookup(table, raw):
+    """analog_to_celsius(): binary search for the bracketing entries, then float interpolation. Returns (°C, steps)."""
+    l, r, steps = 0, len(table), 0
+    while True:
+        steps += 1
+        m = (l + r) >> 1
+        if not m: return float(table[0][1]), steps
+        if m == l or m == r: return float(table[-1][1]), steps
+        v00, v10 = table[m - 1][0], table[m][0]
+        if raw < v00: r = m
+        elif raw > v10: l = m
+        else:
+            c00, c10 = table[m - 1][1], table[m][1]
+            return c00 + (raw - v00) * float(c10 - c00) * (1.0 / (v10 - v00)), steps
+
+def marlin_cycles(steps, ws):
+    """Per search step: ADD, LSR, two LDRH, two CMP and branches. Interpolation: two more LDRSH, SUBs,
+    three VCVT, VDIV (the reciprocal), two VMUL, VADD, plus call and return."""
+    return steps * (2 * (1 + ws) + 8) + 2 * (1 + ws) + 3 + 3 + 14 + 2 + 1 + 4
+
+def compare_table51(args, lut, step):
+    path = Path(args.table or Path(args.config, 'src', 'module', 'thermistor', 'thermistor_51.h'))
+    if not path.exists():
+        print('Table 51 not found at %s: pass --table to compare with it' % path)
+        return
+    table = marlin_table(path)
+    worst = { 'lut': (0.0, 0), 'table51': (0.0, 0), 'diff': (0.0, 0) }
+    steps, raws = [], []
+    for t10 in range(args.min * 10, args.max * 10 + 1):
+        t = t10 / 10.0
+        raw = int(round(adc(t, args.r25, args.beta, args.pullup)))
+        model = temp_from_adc(raw, args.r25, args.beta, args.pullup)
+        a = lut_lookup(lut, step, args.frac, raw)
+        b, n = marlin_lookup(table, raw)
+        steps.append(n)
+        raws.append(raw)
+        for key, err in (('lut', a - model), ('table51', b - model), ('diff', a - b)):
+            worst[key] = max(worst[key], (abs(err), t))
+    print('Table 51 (%s), %d entries, %d bytes:' % (path.name, len(table), 4 * len(table)))
+    print('  max error against the model: table 51 %.2f °C at %.1f °C, new table %.2f °C at %.1f °C' % (
+        worst['table51'] + worst['lut']))
+    print('  max difference new table - table 51: %.2f °C at %.1f °C' % worst['diff'])
+    avg = sum(steps) / len(steps)
+    print('  %-10s %13s %13s %13s %13s' % ('Lookup', 'Search steps', 'Cycles avg', 'Cycles max', 'Host ns'))
+    ns_t51 = 1e9 * timeit.timeit(lambda: [ marlin_lookup(table, r) for r in raws ], number=3) / (3 * len(raws))
+    ns_lut = 1e9 * timeit.timeit(lambda: [ lut_lookup(lut, step, args.frac, r) for r in raws ], number=3) / (3 * len(raws))
+    print('  %-10s %13.1f %13.0f %13.0f %13.0f' % ('table 51', avg, marlin_cycles(avg, args.flash_ws),
+        marlin_cycles(max(steps), args.flash_ws), ns_t51))
+    print('  %-10s %13d %13d %13d %13.0f' % ('new table', 0, lut_cycles(args.flash_ws), lut_cycles(args.flash_ws), ns_lut))
+    print('  At %.0f MHz: %.2f us vs %.2f us per reading' % (F_CPU / 1e6, marlin_cycles(avg, args.flash_ws) / F_CPU * 1e6,
+        lut_cycles(args.flash_ws) / F_CPU * 1e6))
+
+def report_lut(args):
+    lut, step = build_lut(args.lut, args.frac, args.r25, args.beta, args.pullup)
+    worst = (0.0, 0)
+    for t10 in range(args.min * 10, args.max * 10 + 1):
+        t = t10 / 10.0
+        raw = int(round(adc(t, args.r25, args.beta, args.pullup)))
+        err = abs(lut_lookup(lut, step, args.frac, raw) - temp_from_adc(raw, args.r25, args.beta, args.pullup))
+        worst = max(worst, (err, t))
+    print('%d entries, %d bytes: max error %.3f °C at %.1f °C over %d..%d °C' % (
+        len(lut), 2 * len(lut), worst[0], worst[1], args.min, args.max))
+    compare_table51(args, lut, step)
+    if args.emit:
+        print('\n// %dΩ pull-up, %dΩ R25, beta %d. index = raw >> %d (12-bit ADC), value = °C * %d' % (
+            args.pullup, args.r25, args.beta, step.bit_length() - 1, 1 << args.frac))
+        print('constexpr int16_t uni_temptable[%d] = {' % len(lut))
+        for i in range(0, len(lut), 8):
+            print('  ' + ', '.join('%5d' % v for v in lut[i:i + 8]) + ',')
+        print('};')
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n\n')[1])
+    ap.add_argument('--r25', type=float, default=100000)
+    ap.add_argument('--beta', type=float, default=4092)
+    ap.add_argument('--pullup', type=float, default=1000, help='UNI pull-up (R501/R502)')
+    ap.add_argument('--stock-pullup', type=float, default=4700, help='pull-up the stock table assumes')
+    ap.add_argument('--lut', type=int, metavar='BITS', help='build an evenly indexed table with 2^BITS + 1 entries')
+    ap.add_argument('--frac', type=int, default=4, help='fractional bits of the table values')
+    ap.add_argument('--min', type=int, help='lowest temperature checked (default: HEATER_0_MINTEMP)')
+    ap.add_argument('--max', type=int, help='highest temperature checked (default: HEATER_0_MAXTEMP)')
+    ap.add_argument('--emit', action='store_true', help='print the table as C')
+    ap.add_argument('--config', default='Marlin', help='Marlin directory holding Configuration.h and src/module/thermistor')
+    ap.add_argument('--table', help='Marlin thermistor_51.h to compare with')
+    ap.add_argument('--flash-ws', type=int, default=2, help='flash wait states per table load (84 MHz: 2)')
+    args = ap.parse_args()
+
+    if args.min is None or args.max is None:
+        text = Path(args.config, 'Configuration.h').read_text(errors='ignore')
+        if args.min is None: args.min = int(config_value(text, 'HEATER_0_MINTEMP'))
+        if args.max is None: args.max = int(config_value(text, 'HEATER_0_MAXTEMP'))
+
+    if args.lut:
+        report_lut(args)
+        return
+
+    print('%6s %10s %12s %12s %14s' % ('°C', 'ADC', '°C/count', '°C/count', 'Stock table'))
+    print('%6s %10s %12s %12s %14s' % ('', '(UNI)', '(UNI)', '(stock)', 'reads (°C)'))
+    for t in (5, 25, 50, 80, 100, 150, 180, 200, 220, 240, 250, 260, 275, 300):
+        uni = adc(t, args.r25, args.beta, args.pullup)
+        res_uni = 1.0 / abs(adc(t + 0.5, args.r25, args.beta, args.pullup) - adc(t - 0.5, args.r25, args.beta, args.pullup))
+        res_stock = 1.0 / abs(adc(t + 0.5, args.r25, args.beta, args.stock_pullup) - adc(t - 0.5, args.r25, args.beta, args.stock_pullup))
+        wrong = temp_from_adc(uni, args.r25, args.beta, args.stock_pullup)
+        print('%6d %10.0f %12.3f %12.3f %14.1f' % (t, uni, res_uni, res_stock, wrong))
+
+if __name__ == '__main__':
+    main()